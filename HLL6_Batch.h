@@ -0,0 +1,160 @@
+#pragma once
+/*	CLASS compileBatch
+
+Compiles many HLL6 source files at once, a compiler per file, on a pool of threads.
+
+The compilers share nothing: each is given its source by name, writes its own object file and
+listing and reports its diagnostics to a console of its own, so a file's messages are never mixed
+with another's. The threads take the next file not yet compiled until there is none left; the
+results are kept in the order of the files, whatever order they finished in. Only the compile cache
+is shared, and it is safe to use from any number of compilers.
+
+The object of a source goes beside it, its extension replaced by .OUT.txt (TestFile1.txt gives
+TestFile1.OUT.txt), and the listing of listFile by .LST.txt or .LST.jsonl.
+
+	vector<string> files = { "TestFile1.txt", "TestFile2.txt", "TestFile3.txt" };
+	compiler::compileOptions options;
+	options.listing = compiler::listNone;
+	compileBatch batch(files, options);
+	batch.report(cout);
+
+*/
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <filesystem>
+#include "HLL6_Compiler.h"
+
+using namespace std;
+
+/*=============================================================*/
+
+class compileBatch
+{
+public:
+	struct fileResult { string source, object, diagnostics; bool compiled; };
+
+	// threads == 0 takes one thread per core
+	compileBatch(const vector<string> &sources, const compiler::compileOptions &options, unsigned threads = 0);
+	~compileBatch() {}
+
+	const vector<fileResult> &results(void) { return files; }
+	int failures(void);
+	void report(ostream &out);
+
+private:
+	vector<fileResult> files;
+	compiler::compileOptions options;
+	atomic<size_t> nextFile;
+
+	void worker(void);
+	void compileOne(fileResult &file);
+	static string sibling(const string &source, const char *extension);
+}; // class compileBatch
+
+/*==================================================================*/
+/*==================================================================*/
+
+//-----------//
+//CONSTRUCTOR//
+//-----------//
+inline compileBatch::compileBatch(const vector<string> &sources, const compiler::compileOptions &options, unsigned threads)
+	: options(options), nextFile(0)
+{
+	for (const string &source : sources)
+		files.push_back({ source, sibling(source, ".OUT.txt"), "", false });
+
+	if (threads == 0) threads = thread::hardware_concurrency();
+	if (threads > files.size()) threads = (unsigned)files.size();
+	if (threads <= 1) { worker(); return; }
+
+	vector<thread> pool;
+	for (unsigned i = 0; i < threads; i++)
+		pool.emplace_back(&compileBatch::worker, this);
+	for (thread &t : pool)
+		t.join();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void worker(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compileBatch::worker(void)
+{
+	// each file is taken by exactly one thread
+	for (size_t i; (i = nextFile.fetch_add(1, memory_order_relaxed)) < files.size(); )
+		compileOne(files[i]);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void compileOne(fileResult &file)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compileBatch::compileOne(fileResult &file)
+{
+	ostringstream console;
+	compiler::compileOptions fileOptions = options;
+	fileOptions.sourceName = file.source;
+	fileOptions.objectName = file.object;
+	fileOptions.listName = sibling(file.source, options.jsonLines ? ".LST.jsonl" : ".LST.txt");
+	fileOptions.console = &console;
+	fileOptions.incremental = nullptr;		// these belong to a single compile
+	fileOptions.stream = nullptr;
+
+	compiler fileCompiler(fileOptions);
+	file.compiled = fileCompiler.compiled();
+	file.diagnostics = console.str();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							int failures(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compileBatch::failures(void)
+{
+	int n = 0;
+	for (const fileResult &file : files)
+		if (!file.compiled) n++;
+	return n;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void report(ostream &out)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compileBatch::report(ostream &out)
+{
+	// the diagnostics of each file under its name, in the order of the files
+	for (const fileResult &file : files)
+		if (!file.diagnostics.empty())
+			out << file.source << ':' << file.diagnostics << endl;
+	out << files.size() - failures() << " of " << files.size() << " files compiled." << endl;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		string sibling(const string &source, const char *extension)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline string compileBatch::sibling(const string &source, const char *extension)
+{
+	filesystem::path name(source);
+	return name.replace_extension(extension).string();
+}
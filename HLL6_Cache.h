@@ -0,0 +1,229 @@
+#pragma once
+/*	CLASS compileCache
+
+A content-addressed cache of compiled ILL5 objects, used by the HLL6 compiler.
+
+An object is filed under a key, the SHA-256 the compiler takes of the HLL6 source, the compiler
+version and the options that change the code. Entries are files in a local directory; each is
+written to a temporary file first and then renamed into place, so a reader never sees half an
+object. When the entries grow beyond the size bound the least recently used ones are removed; a
+hit counts as a use. The cache is best effort: when the directory cannot be read or written it
+simply misses.
+
+*/
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <cstring>
+
+using namespace std;
+
+#define cacheDir      "HLL6.cache"		//directory of the compile cache
+#define cacheMaxBytes (16 << 20)		//size bound of the cache directory
+
+/*=============================================================*/
+
+class compileCache
+{
+public:
+	compileCache(const char *dir = cacheDir, uintmax_t maxBytes = cacheMaxBytes) : dir(dir), maxBytes(maxBytes) {}
+	~compileCache() {}
+
+	static string sha256(const string &data);
+	bool fetch(const string &key, string &object);
+	void store(const string &key, const string &object);
+
+	static long hits(void)   { return hitCount; }
+	static long misses(void) { return missCount; }
+
+private:
+	filesystem::path dir;
+	uintmax_t maxBytes;
+
+	static atomic<long> hitCount, missCount, tempCount;
+
+	filesystem::path entryPath(const string &key) { return dir / (key + ".ill5"); }
+	static void sha256Block(uint32_t h[8], const unsigned char *p);
+	void trim(void);
+}; // class compileCache
+
+inline atomic<long> compileCache::hitCount(0);
+inline atomic<long> compileCache::missCount(0);
+inline atomic<long> compileCache::tempCount(0);
+
+/*==================================================================*/
+/*==================================================================*/
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					string sha256(const string &data)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline string compileCache::sha256(const string &data)
+{
+	// FIPS 180-4 SHA-256, returned as 64 hex digits
+	uint32_t h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+	size_t whole = data.size() - data.size() % 64;
+	for (size_t block = 0; block < whole; block += 64)
+		sha256Block(h, (const unsigned char *)data.data() + block);
+
+	// pad the rest with a 1 bit, zeros and the length in bits to a multiple of 64 bytes
+	unsigned char tail[128] = { 0 };
+	size_t rest = data.size() - whole, tailLen = rest < 56 ? 64 : 128;
+	memcpy(tail, data.data() + whole, rest);
+	tail[rest] = 0x80;
+	uint64_t bits = (uint64_t)data.size() * 8;
+	for (int i = 0; i < 8; i++) tail[tailLen - 1 - i] = (unsigned char)(bits >> (8 * i));
+	for (size_t block = 0; block < tailLen; block += 64)
+		sha256Block(h, tail + block);
+
+	static const char hex[] = "0123456789abcdef";
+	string digest;
+	for (int i = 0; i < 8; i++)
+		for (int shift = 28; shift >= 0; shift -= 4)
+			digest += hex[(h[i] >> shift) & 15];
+	return digest;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//			void sha256Block(uint32_t h[8], const unsigned char *p)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compileCache::sha256Block(uint32_t h[8], const unsigned char *p)
+{
+	// fold one 64-byte block into the hash state h
+	static const uint32_t k[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+		0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+		0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+		0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+		0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+		0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+	};
+	uint32_t w[64];
+	for (int i = 0; i < 16; i++, p += 4)
+		w[i] = (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+	for (int i = 16; i < 64; i++)
+	{
+		uint32_t s0 = (w[i - 15] >> 7 | w[i - 15] << 25) ^ (w[i - 15] >> 18 | w[i - 15] << 14) ^ (w[i - 15] >> 3);
+		uint32_t s1 = (w[i - 2] >> 17 | w[i - 2] << 15) ^ (w[i - 2] >> 19 | w[i - 2] << 13) ^ (w[i - 2] >> 10);
+		w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+	}
+
+	uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+	for (int i = 0; i < 64; i++)
+	{
+		uint32_t s1 = (e >> 6 | e << 26) ^ (e >> 11 | e << 21) ^ (e >> 25 | e << 7);
+		uint32_t t1 = hh + s1 + ((e & f) ^ (~e & g)) + k[i] + w[i];
+		uint32_t s0 = (a >> 2 | a << 30) ^ (a >> 13 | a << 19) ^ (a >> 22 | a << 10);
+		uint32_t t2 = s0 + ((a & b) ^ (a & c) ^ (b & c));
+		hh = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e; h[5] += f; h[6] += g; h[7] += hh;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				bool fetch(const string &key, string &object)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool compileCache::fetch(const string &key, string &object)
+{
+	error_code ec;
+	filesystem::path entry = entryPath(key);
+	ifstream in(entry, ios::binary);
+	if (in)
+	{
+		ostringstream text;
+		text << in.rdbuf();
+		if (in)
+		{
+			object = text.str();
+			filesystem::last_write_time(entry, filesystem::file_time_type::clock::now(), ec); // used just now
+			hitCount++;
+			return true;
+		}
+	}
+	missCount++;
+	return false;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//			void store(const string &key, const string &object)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compileCache::store(const string &key, const string &object)
+{
+	// write a temporary file beside the entry and rename it into place
+	error_code ec;
+	filesystem::create_directories(dir, ec);
+	filesystem::path entry = entryPath(key);
+	filesystem::path temp = entry;
+	temp += ".tmp" + to_string(hash<thread::id>()(this_thread::get_id())) + "." + to_string(tempCount++);
+
+	{
+		ofstream out(temp, ios::binary);
+		out.write(object.data(), object.size());
+		if (!out)
+		{
+			out.close();
+			filesystem::remove(temp, ec);
+			return;
+		}
+	}
+	filesystem::rename(temp, entry, ec);
+	if (ec) filesystem::remove(temp, ec);
+	else trim();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void trim(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compileCache::trim(void)
+{
+	// remove the least recently used entries until the cache fits in maxBytes
+	struct entryRec { filesystem::file_time_type used; uintmax_t size; filesystem::path path; };
+	vector<entryRec> entries;
+	uintmax_t total = 0;
+	error_code ec;
+
+	for (filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (it->path().extension() != ".ill5") continue;
+		error_code fileEc;
+		entryRec rec = { it->last_write_time(fileEc), it->file_size(fileEc), it->path() };
+		if (fileEc) continue;
+		entries.push_back(rec);
+		total += rec.size;
+	}
+	if (total <= maxBytes) return;
+
+	sort(entries.begin(), entries.end(), [](const entryRec &x, const entryRec &y) { return x.used < y.used; });
+	for (size_t i = 0; i < entries.size() && total > maxBytes; i++)
+		if (filesystem::remove(entries[i].path, ec))
+			total -= entries[i].size;
+}
@@ -1,3 +1,4 @@
+#pragma once
 #ifdef _MSC_VER
 #define _CRT_SECURE_NO_WARNINGS
 #endif
@@ -7,22 +8,38 @@ This program accepts a sentence in the language HLL6 and translates it into a se
 equivalent sentence in the language ILL5.
 
 Grammer of HLL6:
-<HLL6-sentence>   -> <varDeclSection> <mainProgSection> '.'
-<varDeclaration>  -> 'DECLARE' <varIdent> { ',' <varIdent> } ';'
+<HLL6-sentence>   -> <varDeclSection> { <procDeclaration> } <mainProgSection> '.'
+<varDeclaration>  -> 'DECLARE' <varDecl> { ',' <varDecl> } ';'
+<varDecl>         -> <varIdent> [ '[' <number> ']' ]
+<procDeclaration> -> 'PROCEDURE' <varIdent> [ '(' <varIdent> { ',' <varIdent> } ')' ] ';'
+                     [ 'DECLARE' <varIdent> { ',' <varIdent> } ';' ] 'BEGIN' <statSequence> 'END' ';'
 <varIdent>        -> <letter> { <letter> | <digit> }
 <mainProgSection> -> 'BEGIN' <statSequence> 'END'
 <statSequence>    -> <statement> { ';' <statement> }
-<statement>       -> <i-assignStat> | <writeStat> | <ifStat> | <whileStat>					
+<statement>       -> <i-assignStat> | <a-assignStat> | <writeStat> | <readStat> | <ifStat> | <whileStat> |
+                     <forStat> | <caseStat> | <fillStat> | <callStat>
+<callStat>        -> <varIdent> [ '(' <i-expression> { ',' <i-expression> } ')' ]
 <whileStat>       -> 'WHILE' <condition> 'DO' <statSequence> 'END'							
+<forStat>         -> 'FOR' <varIdent> ':=' <i-expression> 'TO' <i-expression> [ 'STEP' [ '-' ] <number> ] 'DO'
+                     <statSequence> 'END'
 <ifStat>		  -> 'IF' <condition> 'THEN' <statSequence> [ 'ELSE' <statSequence> ] 'END' 
-<condition>		  -> <i-expression> <relOp> <i-expression>									
+<caseStat>        -> 'CASE' <i-expression> 'OF' <caseArm> { ';' <caseArm> } [ 'ELSE' <statSequence> ] 'END'
+<caseArm>         -> <number> { ',' <number> } ':' <statSequence>
+<condition>       -> <conjunction> { 'OR' <conjunction> }
+<conjunction>     -> <negation> { 'AND' <negation> }
+<negation>        -> 'NOT' <negation> | '(' <condition> ')' | <i-expression> <relOp> <i-expression>
 <relOp>			  -> '=' | '#' | '<' | '<=' | '>' | '>='									
 <writeStat>       -> 'WRITE' <writeParam> | 'ENDL'
-<writeParam>      ->  <varIdent> | <number> | <charString>
-<i-assignStat>    -> <varIdent> ':=' <i-expression>
+<readStat>        -> 'READ' <variable>
+<writeParam>      ->  <variable> | <number> | <charString>
+<i-assignStat>    -> <variable> ':=' <i-expression>
+<a-assignStat>    -> <varIdent> ':=' <varIdent> [ ( '+' | '-' | '*' ) <varIdent> ]
+<fillStat>        -> 'FILL' '(' <varIdent> ',' <i-expression> ')'
+<variable>        -> <varIdent> [ '[' <i-expression> ']' ]
 <i-expression>    -> <term> { ( '+' | '-') <term> }
 <term>            -> <factor> { ( '*' | '/' ) <factor> }
-<factor>          -> <number> | <varIdent> | '(' <i-expression> ')'
+<factor>          -> <number> | <variable> | <reduction> | 'EOF' | '(' <i-expression> ')'
+<reduction>       -> ( 'SUM' | 'MIN' | 'MAX' ) '(' <varIdent> ')'
 <number>          -> <digit> { <digit> }
 <digit>           -> '0' | '1' | '2' | '3' | '4' | '5' | '6' | '7' | '8' | '9'
 <letter>          -> 'a' | 'b' | ... | 'z' | 'A' | 'B' | ... | 'Z'
@@ -40,67 +57,283 @@ The semantic rules which augment the grammar rules above are:
 a pair of double quotes, or a pair of single quotes, mixed quotes are not allowed.
 (6) The quotes of a string must appear on the same line, i.e., the leseme of a
 <charString> may not extend over the line.
+(7) Source lines may be of any length; blanks, tabs and line ends all separate symbols.
+(8) A variable declared with a size is an array of that many elements, indexed from 0; it must
+always be indexed, and a scalar variable never. The arrays are laid out after the scalars. An index
+is checked at run time, unless the compiler can prove it in range: a constant, or the counter of a
+counted WHILE loop plus or minus a constant (see countedLoop()).
+(9) The whole-array statements and reductions take arrays by name, without an index: c := a copies
+a into c, c := a + b adds a and b element by element, FILL(a, e) sets every element of a to e, and
+SUM(a), MIN(a) and MAX(a) are the sum, the smallest and the largest element of a. The arrays of a
+statement must be of the same size. Each compiles to a single bulk p-instruction.
+(10) READ stores the next integer of the program's input in its variable, and EOF is 1 once nothing
+but blanks and line ends is left of the input, 0 before; reading past the end is a run-time error.
+(11) A procedure is declared before it is called, and may call itself. Its parameters are passed by
+value, and they and its variables, which must be scalars, live in a frame of its own on the stack;
+the variables start at 0, and both may hide global variables of the same names. It is called by
+a statement that names it with as many arguments as it has parameters. A call compiles to a CAL,
+unless the procedure is small and does not call itself: then, when the code is optimized, a copy
+of its body is put in place of the call, with its parameters and variables in global slots of
+their own. A call of a procedure by itself that is the last thing it does, a tail call, compiles
+to a TCL, which goes on in the frame of the call it ends instead of taking a new one.
+(12) A CASE runs the arm one of whose labels is the value of its expression, or else the ELSE part,
+if any; a label may be used once. Labels close enough together share a jump table, a JTB that
+takes the target of the entry the value selects, and a binary search leads to those tables and to
+the labels left (see caseDispatch()).
+(13) NOT binds closer than AND, and AND closer than OR. A condition is compiled to a chain of
+compare-and-branch jumps that yields no truth value: the right operand of an AND is not evaluated
+when the left one is false, nor that of an OR when the left one is true. A '(' groups a condition
+when a relation follows inside it before its ')', and an expression otherwise.
+(14) A FOR sets its variable, a scalar, to the first expression and runs its statements for as
+long as the variable has not passed the limit, the second expression, adding the step to it after
+each run; the step is a constant other than 0, 1 if it is left out. The limit is evaluated once,
+before the variable is set. The increment, the comparison and the jump back are a single LOP.
 
 
 Grammer of ILL5:
 <ILL5-sentence>  -> <p-instruction> { <p-instruction> } 'HLT'
 <p-instruction>  -> <p-mnemonic> [ <argument> ]
 <p-mnemonic>     -> 'ADD' | 'SUB' | 'MUL' | 'DVD' | 'LDI' | 'PRN' | 'LDA' | 'LDV' | 'STO' | 'INT' |
-'PRC' | 'PRS' | 'NLN' | 'EQL' | 'NEQ' | 'LSS' | 'LEQ' | 'GTR' | 'GEQ' | 'JMP' | 'JMZ' | 'NUL'
+'PRC' | 'PRS' | 'NLN' | 'EQL' | 'NEQ' | 'LSS' | 'LEQ' | 'GTR' | 'GEQ' | 'JMP' | 'JMZ' | 'SHL' |
+'SAR' | 'MLI' | 'DVI' | 'JEQ' | 'JNE' | 'JLT' | 'JLE' | 'JGT' | 'JGE' | 'LDX' | 'STX' | 'CHK' | 'SUM' |
+'MIN' | 'MAX' | 'FIL' | 'VAD' | 'VSB' | 'VML' | 'CPY' | 'RDI' | 'EOF' | 'CAL' | 'ENT' | 'RET' | 'LLA' | 'TCL' | 'JTB' | 'LOP' |
+'NUL'
 <argument>       -> <number>
 
+Before it is written, the p-code is improved by optimize():
+(1) local value numbering, a value already computed in a basic block is taken from a constant, a
+variable holding it, or a compiler-allocated temporary instead of being recomputed.
+(2) a conditional jump or a JTB on a constant is folded and code that can no longer be reached is removed.
+(3) a multiplication or division by a constant becomes a shift, MLI or DVI, and in a loop the
+product of an induction variable and a constant is kept up to date by an addition when that is cheaper.
+(4) a store whose value is never read is removed, and unused variables give up their slot.
+optimize() works on the whole program, so code that is streamed to the interpreter while it is
+being compiled (see ILL5_Stream.h), or compiled incrementally, is not optimized.
+
 */
 
 
 #include <fstream>
 #include <iostream>
 #include <iomanip>
+#include <sstream>
 #include <string>
+#include <cstring>
+#include <vector>
+#include <unordered_map>
+#include <climits>
+#include <algorithm>
+#include <charconv>
+#include "HLL6_Cache.h"
+#include "ILL5_Stream.h"
 
 using namespace std;
 
-#define lineMax  80
+#define compilerVersion "HLL6 compiler 6.2"	//part of the compile cache key; raise it whenever the code generated changes
 #define MaxInt   32767
-#define tableMax 100
-#define wLeng    8			//length of longest varIdent or HLL6 reserved word
-#define resWords 10			//Number of reserved words in HLL6
+#define codeLimit 1048576	//largest program, in p-instructions
+#define codeChunk 1024		//p-instructions reserved up front
+#define wLeng    8			//width of the VarName column of the symbol table
+#define resWords 25			//Number of reserved words in HLL6
+#define resHashSize 64		//slots of the reserved-word hash, a power of 2
+#define symHashMin  64		//initial slots of the symbol hash, a power of 2
+#define lexStates  32		//states of the lexer's DFA
+#define lexClasses 24		//character classes of the lexer's DFA
+#define unrollFactor  4		//copies of the body in an unrolled counted WHILE loop
+#define unrollMaxCode 256	//largest unrolled loop body, in p-instructions
+#define inlineMaxCode 48	//largest procedure body copied in place of a call, in p-instructions
+#define caseTableMin  4		//fewest labels a CASE jump table is made for
+#define caseTableFill 2		//entries of a CASE jump table per label, at most
 
 /*=============================================================*/
 
 class compiler
 {
 public:
-	compiler(void);  //Constructor
+	// where the compile listing goes; it is buffered and written out at the end of compilation
+	enum listingModes { listConsole, listFile, listMemory, listNone };
+
+	struct compileOptions;
+	struct incrementalState;
+
+	compiler(void);									//Constructor, console listing
+	compiler(const compileOptions &options);		//Constructor
 	~compiler() {};  //Destructor
 
+	string listingText(void) { return listing.str(); }	// the listing kept by listMemory
+	bool compiled(void) { return !hasError; }
+	int addressOf(const string &name);		// where a scalar variable was placed, 0 if nowhere
+
 private:
+	friend class lexerBench;	// LexBench.cpp times the lexer alone
 	char bs, bell;
 	enum symbols{
 		unknownSym, numberSym, plusSym, minusSym, timesSym, slashSym, leftParenSym,
 		rightParenSym, periodSym, semicolonSym, assignSym, varIdentSym, declareSym,
 		beginSym, endSym, writeSym, commaSym, endlSym, stringSym, ifSym, thenSym, elseSym,
-		eqlSym, neqSym, lessSym, gtrSym, geqSym, leqSym, whileSym, doSym
+		eqlSym, neqSym, lessSym, gtrSym, geqSym, leqSym, whileSym, doSym, leftBracketSym, rightBracketSym,
+		sumSym, minSym, maxSym, fillSym, readSym, eofSym, procedureSym, caseSym, ofSym, colonSym,
+		andSym, orSym, notSym, forSym, toSym, stepSym
 	};
 
-	enum opCodes { add, sub, mul, dvd, ldi, lda, ldv, prc, prs, nln, prn, sto, inc, eql, neq, lss, leq, gtr, geq, jmp, jmz, nul, hlt };
+	// inb is a CHK proven to pass; it is written as a CHK unless optimize() drops it
+	// ldb pushes where an array starts for a bulk instruction; it is written as an LDA
+	// jte is an entry of the table that follows a JTB; it is written as a JMP
+	// lop jumps back to its argument; the counter, the limit and the step follow it as an LDA or
+	// LLA, an LDA or LLA and an LDI, which are not run
+	enum opCodes { add, sub, mul, dvd, ldi, lda, ldv, prc, prs, nln, prn, sto, inc, eql, neq, lss, leq, gtr, geq, jmp, jmz, shl, sar, mli, dvi, jeq, jne, jlt, jle, jgt, jge, ldx, stx, chk, inb,
+		ldb, vsm, vmn, vmx, vfl, vad, vsb, vml, vcp, rdi, eoi, cal, ent, ret, lla, tcl, jtb, lop, jte, lbl, nul, hlt };
 
 	ifstream sourceFile;
 	ofstream codeFile;
-
-	int number, nextCode, lineLen, charCount, lastEntry, chStringLen;
+	ofstream listingFile;
+
+	string sourceName, objectName, listName;	// files named by the options, asked for or fixed if not
+	ostream &console;			// the banner, questions and diagnostics
+
+	listingModes listMode;
+	bool listJson;				// listing as JSON lines instead of text
+	ostringstream listing;		// listing not yet written out
+
+	bool useCache;				// look up and file the object code in the compile cache
+	compileCache cache;
+	string cacheKey;
+	incrementalState *incremental;	// remembers this compile for the next one, if set
+	codeStream *stream;				// finished code is passed on here while compiling, if set
+	int published;					// code already put in the stream
+
+	int number, nextCode, lineNo, lastEntry, chStringLen, varAreaLoc, varAreaSize, labelCount;
+	int arrayAreaSize;			// elements of all arrays, laid out after the scalars
+	int joinAt;					// where the last forward jump was patched to land
+	int nesting;				// depth of statement sequences being parsed
+	bool caseArm;				// the next statement sequence is an arm of a CASE, ended by a label
+	int caseSlot;				// where a CASE keeps its selector for a decision tree, 0 until needed
+	int forDepth;				// limits of FORs left on the stack when the code is not optimized
+	bool spliced;				// the rest of the program was taken from the last compile
+	const char *symStart;		// where the current symbol begins
 	bool hasError = false;
-	char ch, strBuff[30], line[lineMax], tableIndex[tableMax], chStringText[lineMax];
-
-	symbols sym, resSymList[resWords + 1];
+	char ch, strBuff[30];
+	string chStringText;
+
+	string source;								// the whole source file
+	const char *srcPos, *srcEnd, *lineStart;	// next character, end of source, start of current line
+	bool srcDone;								// the blank that ends the source has been read
+
+	symbols sym;
+	vector<symbols> exprStack;	// open parentheses and brackets and pending operators of expression()
+	vector<int> indexed;		// the array of each open bracket in exprStack and where its index starts
+	opCodes condOp;			// relation tested by the last condition
+	int condRight;			// where the code of its right operand starts
 	typedef char shortString[4];
-	typedef char alfa[wLeng];
-	alfa id;
-	alfa resWordList[resWords + 1];
-	shortString mnemonic[hlt + 1]; //NUMBER HAS TO BE 1 GREATER THAN THE NUMBER OF opCodes
-	struct symTabRec { alfa name; int address; };
-	symTabRec symTab[tableMax];
+	string id;				// last identifier, in upper case
+	unsigned idHash;		// and its hash
+	static const shortString mnemonic[hlt + 1]; //NUMBER HAS TO BE 1 GREATER THAN THE NUMBER OF opCodes
+	// a global variable's address is its entry, a local's is its place in the frame, and a
+	// procedure's is its entry in procs
+	enum symKinds { globalKind, localKind, procKind };
+	struct symTabRec { string name; int address; unsigned hash; int size; symKinds kind; };	// size 0 for a scalar
+	vector<symTabRec> symTab;	// entry 0 is unused; the globals, then procedures and the locals of the one being compiled
+	vector<int> symHash;		// open addressing over symTab entries, 0 is an empty slot
+
+	// reserved words, placed by a perfect hash computed at compile time
+	struct resWordRec { const char *name; int len; symbols sym; };
+	struct resWordSet { resWordRec slot[resHashSize]; bool perfect; };
+	static constexpr int resHash(const char *w, int len) { return (3 * w[0] + w[1] + w[len - 1] + 2 * len) & (resHashSize - 1); }
+	static constexpr resWordSet makeResWords(void);
+	static const resWordSet resWordTable;
+
+	// the lexer's DFA, built at compile time: a character falls into a class in one lookup, and a
+	// state moves on a class to the next state, or to lexStop when the symbol ends before it.
+	// Identifiers, numbers and strings have loops of their own; the states spell the fixed symbols.
+	enum lexClassNames { otherClass, letterClass, digitClass, dQuoteClass, sQuoteClass, endClass, firstOpClass };
+	enum lexStateNames { lexStop, lexStart, lexBad, firstOpState };
+	struct lexTokenRec { const char *text; symbols sym; };
+	struct lexDfa
+	{
+		unsigned char charClass[256];
+		unsigned char next[lexStates][lexClasses];
+		symbols accept[lexStates];			// the symbol when the DFA stops in the state
+		signed char stopError[lexStates];	// the error when it stops there, 0 if none
+		bool skipAfter[lexStates];			// and then the character it stopped at is skipped
+		symbols single[lexClasses];			// the symbol of a character that no other extends
+		bool fits;
+	};
+	static constexpr lexDfa makeLexDfa(void);
+	static const lexDfa lexTable;
 	struct pInstruction { opCodes op; int arg; };
-	pInstruction pCode[MaxInt];
+	vector<pInstruction> pCode;	// grows as code is generated, up to codeLimit
+
+	// a CASE being lowered: its labels in order of value with the arm each leads to, where the
+	// other values go, and the code of the selector
+	struct caseLabelRec { int value, arm; };
+	struct caseRec { vector<caseLabelRec> labels; int otherwise, slot, tables, compares; vector<pInstruction> selector; };
+
+	// a condition being compiled: the jumps taken when it is true and when it is false, still to be
+	// patched, and which way its code falls through; the last jump of its code is the last of one list
+	struct condRec { vector<int> onTrue, onFalse; bool fallsTrue = true, compound = false; };
+
+	// optimizer form of pCode: 'lbl n' marks a jump target and jump arguments are label numbers
+	typedef vector<pInstruction> codeList;
+	struct codeEdits
+	{
+		vector<bool> deleted;
+		vector<codeList> before, after;
+		codeEdits(int size) : deleted(size, false), before(size), after(size) {}
+	};
+	struct basicBlock { int from, to; vector<int> succ; };
+	struct stackEntry { int vn, start; };
+	struct valueRec { opCodes op; int a, b; };
+	struct valueTable
+	{
+		vector<valueRec> values;							// defining operation of each value number
+		unordered_map<long long, int> lookup;				// (op, a, b) -> value number
+		unordered_map<int, int> varValue;					// variable address -> value number it holds
+		vector<int> inVar, inTemp, firstStart, firstEnd;	// where each value number is available
+		vector<int> occurs;									// values whose first computation is still intact
+		vector<stackEntry> stack;							// symbolic evaluation stack
+		int temps;
+	};
+
+public:
+	// the lexer state before a top-level statement and where its code begins
+	struct statementRec { int start, line, lineStart, codeFrom; };
+
+	// a procedure: where it is entered, and its body between the ENT and the RET; bodyTo is -1
+	// while the body is being compiled, and slots is where an inlined copy keeps its parameters
+	// and variables, 0 until it is first inlined
+	struct procRec { int entry, params, locals, bodyFrom, bodyTo, slots; bool recursive; };
+
+	// what an incremental compile remembers of the last one
+	struct incrementalState
+	{
+		bool valid = false;
+		string source;
+		vector<pInstruction> code;		// not optimized
+		vector<statementRec> stats;		// top-level statements, in order
+		vector<symTabRec> symTab;
+		vector<procRec> procs;
+		vector<int> symHash;
+		int lastEntry = 0, varAreaLoc = 0, arrayAreaSize = 0;
+	};
+
+	struct compileOptions
+	{
+		listingModes listing = listConsole;
+		bool jsonLines = false;					// listing as JSON lines
+		bool useCache = false;					// look up and file the object code in the compile cache
+		incrementalState *incremental = nullptr;	// recompile only what changed since the compile kept here
+		codeStream *stream = nullptr;			// pass on the code of each finished top-level statement
+		string sourceName;						// compile this file instead of asking for one
+		string objectName;						// object file, H.OUT.txt if empty
+		string listName;						// listing file of listFile, H.LST.txt or H.LST.jsonl if empty
+		ostream *console = &cout;				// banner and diagnostics; none of the banner with a sourceName
+	};
+
+private:
+	vector<statementRec> stats;				// top-level statements of this compile
+	vector<procRec> procs;					// procedures, in the order declared
+	int scopeFrom;							// first symTab entry of the procedure being compiled, 0 outside
+	unordered_map<int, int> spliceAt;		// lexer position -> old statement that may follow unchanged
 
 
 	void prologue(void);
@@ -108,46 +341,129 @@ private:
 	void epilogue(void);
 	void getSourceFile(void);
 	void getCodeFile(void);
+	void getListFile(void);
+	void flushListing(void);
+	void jsonString(const char *s, size_t len);
+	bool listText(void)			{ return listMode != listNone && !listJson; }
+	const char *errorText(int n);
 	void gen(opCodes op, int arg);
 	void dumpCode(void);
+	static char *putField(char *p, int width, const char *s, size_t len);
+	static char *putField(char *p, int width, int n);
+	bool fetchCached(void);
+	void publishCode(void);
+	bool resumeIncremental(void);
+	bool spliceStatements(void);
+	void keepIncremental(void);
 	void CGbinaryIntOp(symbols op);
+	void CGconstIntOp(symbols op, int num);
 	void CGprintNumOp(void)			  { gen(prn, 0); }
 	void CGdoCRLF(void)				  { gen(nln, 0); }
 	void CGloadConstant(int num)	  { gen(ldi, num); }
 	void CGloadAddress(int addr)	  { gen(lda, addr); }
+	void CGloadVariable(int entry)	  { if (symTab[entry].kind == localKind) gen(lla, symTab[entry].address); else CGloadAddress(entry); }
 	void CGdereference(void)		  { gen(ldv, 0); }
 	void CGincrementStack(int offset) { gen(inc, offset); }
 	void CGassignment(void)           { gen(sto, 0); }
 	void CGHalt(void)				  { gen(hlt, 0); }
-	void CGrelOp(opCodes op)		  { gen(op, 0); }
-	void CGjumpOnFalse(int arg)		  { gen(jmz, arg); }
+	void CGloadElement(int base)	  { gen(ldx, base); }
+	void CGstoreElement(int base)	  { gen(stx, base); }
+	void CGcheckIndex(int indexStart, int size);
+	void CGloadBase(int base)		  { gen(ldb, base); }
+	void CGbulkOp(opCodes op, int size) { gen(op, size); }
+	void CGread(void)				  { gen(rdi, 0); }
+	void CGendOfInput(void)			  { gen(eoi, 0); }
+	void CGjumpOnFalse(int arg)		  { gen(branchOn(condOp, false), arg); }
 	void CGJump(int arg)			  { gen(jmp, arg); }
+	void CGcall(int entry)			  { gen(cal, entry); }
+	void CGenter(int locals)		  { gen(ent, locals); }
+	void CGreturn(int params)		  { gen(ret, params); }
 	void CGprintString(void);
 	void backPatch(int loc, int arg);
+	void backPatch(const vector<int> &locs, int arg) { for (int loc : locs) backPatch(loc, arg); }
 	void error(int n);
 	void GetCh(void);
+	void readSource(void);
+	void listLine(void);
+	void skipBlanks(void);
 	void getSym(void);
 	void compile(void);
 	void parseSymbol(void);
 	void accept(symbols expected, int errorNum);
 	void assignStat(void);
+	void arrayAssignStat(int arrayEntry);
+	int  arrayOperand(int size);
+	void fillStat(void);
 	void writeStat(void);
+	void readStat(void);
 	void statement(void);
 	void statementSequence(void);
 	void mainProgSection(void);
 	void varDeclaration(void);
+	void procDeclaration(void);
+	void enterLocal(symKinds kind, int address);
+	void leaveScope(void);
+	void callStat(int procEntry);
+	bool inlineCall(int procEntry);
+	void tailCalls(procRec &proc, const string &name);
+	bool argumentInPlace(const procRec &proc, int param, int from);
+	void inlineCode(procRec &proc, const vector<vector<pInstruction> > &inPlace);
+	void placeArrays(void);
+	void indexExpression(int arrayEntry);
 	void printSymTab(void);
-	void expression(void);
-	void term(void);
-	void factor(void);
+	int  expression(int opened = 0);
 	void enter(void);
 	void searchIdLoc(int &idEntry);
-	void condition(void);
+	int  findSymSlot(void);
+	void growSymHash(void);
+	void hashSymbols(void);
+	void condition(condRec &c);
+	void negation(condRec &c);
+	void conjunction(condRec &c);
+	void disjunction(condRec &c);
+	void flipJump(condRec &c);
 	void ifStat(void);
 	void whileStat(void);
-
-	bool isDigit(void);
-	bool isLetter(void);
+	void forStat(void);
+	void caseStat(void);
+	void caseDispatch(caseRec &c);
+	void caseTree(caseRec &c, const vector<pair<int, int> > &clusters, int from, int to);
+	void CGcaseSelector(caseRec &c);
+	void moveCode(int from, int mid, int to);
+	bool countedLoop(int condStart, int rightStart, int guard, int bodyStart, int bodyEnd, opCodes relOp, int &var, int &step, bool &counted);
+	void proveIndexes(int condStart, int rightStart, int guard, int bodyStart, int incr, opCodes relOp, int var);
+	void unrollLoop(int rightStart, int guard, int bodyStart, int bodyEnd, opCodes relOp, int var, int step);
+	int  CGloopTest(int var, int offset, int boundFrom, int boundTo, opCodes branch, int target);
+	void copyCode(int from, int to);
+
+
+	void optimize(void);
+	void toLabelled(codeList &code);
+	void fromLabelled(codeList &code);
+	void applyEdits(codeList &code, codeEdits &edits);
+	void buildBlocks(codeList &code, vector<basicBlock> &blocks);
+	void stackEffect(codeList &code, int i, int &pops, int &pushes);
+	void operandStarts(codeList &code, vector<basicBlock> &blocks, vector<int> &top, vector<int> &below);
+	void valueNumbering(codeList &code);
+	void foldBranches(codeList &code);
+	void removeUnreachable(codeList &code);
+	void constIntOp(opCodes op, int num, codeList &out);
+	void reduceStrength(codeList &code);
+	bool reduceInduction(codeList &code);
+	bool removeDeadStores(codeList &code);
+	void compactVariables(codeList &code);
+	int  numberBlock(codeList &code, int from, int to, codeEdits &edits);
+	int  valueOf(valueTable &vt, opCodes op, int a, int b);
+	int  freshValue(valueTable &vt);
+	int  combineValues(valueTable &vt, opCodes op, int a, int b);
+	void reuseValue(valueTable &vt, codeEdits &edits, int vn, int start, int end);
+	int  editedLength(codeEdits &edits, int from, int to, int most);
+	opCodes branchOn(opCodes relOp, bool outcome);
+	opCodes complement(opCodes relOp);
+	bool isJump(opCodes op)   { return op == jmp || op == jmz || (op >= jeq && op <= jge) || isCall(op) || op == lop || op == jte; }
+	bool isCall(opCodes op)   { return op == cal || op == tcl; }
+	bool hasArg(opCodes op)   { return op == ldi || op == inc || op == lda || isJump(op) || (op >= shl && op <= dvi) || (op >= ldx && op <= vcp) || (op >= ent && op <= jte); }
+	bool endsBlock(opCodes op) { return isJump(op) || op == hlt || op == ret || op == jtb; }
 }; // class compiler
 
 /*==================================================================*/
@@ -156,7 +472,136 @@ private:
 //-----------//
 //CONSTRUCTOR//
 //-----------//
-compiler::compiler(void) { prologue(); initialize(); compile(); epilogue(); }
+inline compiler::compiler(void) : compiler(compileOptions()) {}
+
+inline compiler::compiler(const compileOptions &options) : sourceName(options.sourceName), objectName(options.objectName),
+	listName(options.listName), console(*options.console), listMode(options.listing), listJson(options.jsonLines),
+	useCache(options.useCache && options.incremental == nullptr && options.stream == nullptr),
+	incremental(options.incremental), stream(options.stream), published(0)
+{
+	prologue(); initialize();
+	if (!sourceFile.is_open()) error(22);
+	else if (!codeFile.is_open() || (listMode == listFile && !listingFile.is_open())) error(23);
+	else if (!fetchCached()) compile();
+	epilogue();
+}
+
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						resWordSet makeResWords(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline constexpr compiler::resWordSet compiler::makeResWords(void)
+{
+	// list of HLL6 reserved words and their grammar symbols, each put in the slot resHash() gives it
+	const resWordRec words[resWords] = {
+		{ "BEGIN", 5, beginSym }, { "DECLARE", 7, declareSym }, { "DO", 2, doSym },
+		{ "ELSE", 4, elseSym },   { "END", 3, endSym },         { "ENDL", 4, endlSym },
+		{ "IF", 2, ifSym },       { "THEN", 4, thenSym },       { "WHILE", 5, whileSym },
+		{ "WRITE", 5, writeSym }, { "SUM", 3, sumSym },         { "MIN", 3, minSym },
+		{ "MAX", 3, maxSym },     { "FILL", 4, fillSym },       { "READ", 4, readSym },
+		{ "EOF", 3, eofSym },     { "PROCEDURE", 9, procedureSym }, { "CASE", 4, caseSym },
+		{ "OF", 2, ofSym },       { "AND", 3, andSym },         { "OR", 2, orSym },
+		{ "NOT", 3, notSym },     { "FOR", 3, forSym },         { "TO", 2, toSym },
+		{ "STEP", 4, stepSym }
+	};
+	resWordSet set = {};
+	set.perfect = true;
+	for (int i = 0; i < resWords; i++)
+	{
+		resWordRec &slot = set.slot[resHash(words[i].name, words[i].len)];
+		if (slot.name != nullptr) set.perfect = false;
+		slot = words[i];
+	}
+	return set;
+}
+
+inline constexpr compiler::resWordSet compiler::resWordTable = compiler::makeResWords();
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						lexDfa makeLexDfa(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline constexpr compiler::lexDfa compiler::makeLexDfa(void)
+{
+	// HLL6 symbols spelled with fixed characters; each gets a path of states from lexStart
+	const lexTokenRec tokens[] = {
+		{ "+", plusSym },      { "-", minusSym },      { "*", timesSym },    { "/", slashSym },
+		{ "(", leftParenSym }, { ")", rightParenSym }, { ";", semicolonSym }, { ".", periodSym },
+		{ ",", commaSym },     { ":=", assignSym },    { "=", eqlSym },      { "#", neqSym },
+		{ "<", lessSym },      { "<=", leqSym },       { ">", gtrSym },      { ">=", geqSym },
+		{ "[", leftBracketSym }, { "]", rightBracketSym }, { ":", colonSym }
+	};
+	lexDfa dfa = {};
+	dfa.fits = true;
+	for (int c = 'A'; c <= 'Z'; c++) dfa.charClass[c] = dfa.charClass[c + 32] = letterClass;
+	for (int c = '0'; c <= '9'; c++) dfa.charClass[c] = digitClass;
+	dfa.charClass[(unsigned char)'"'] = dQuoteClass;
+	dfa.charClass[(unsigned char)'\''] = sQuoteClass;
+
+	// any character that starts no symbol is taken and reported
+	for (int k = 0; k < lexClasses; k++) dfa.next[lexStart][k] = lexBad;
+	dfa.stopError[lexBad] = 4;
+
+	// the fixed symbols; their characters get classes of their own as they come up
+	int states = firstOpState, classes = firstOpClass;
+	for (const lexTokenRec &token : tokens)
+	{
+		int state = lexStart;
+		for (const char *c = token.text; *c != '\0' && dfa.fits; c++)
+		{
+			unsigned char &k = dfa.charClass[(unsigned char)*c];
+			if (k == otherClass)
+			{
+				if (classes == lexClasses) { dfa.fits = false; break; }
+				k = (unsigned char)classes++;
+			}
+			if (dfa.next[state][k] == lexBad || dfa.next[state][k] == lexStop)
+			{
+				if (states == lexStates) { dfa.fits = false; break; }
+				dfa.next[state][k] = (unsigned char)states++;
+			}
+			state = dfa.next[state][k];
+		}
+		dfa.accept[state] = token.sym;
+	}
+
+	// a state on the way to a symbol that is no symbol itself wants the rest
+	for (int state = firstOpState; state < states; state++)
+		if (dfa.accept[state] == unknownSym)
+		{
+			dfa.stopError[state] = 8;
+			dfa.skipAfter[state] = true;
+		}
+
+	// a symbol of one character that nothing follows is known from its class alone
+	for (int k = firstOpClass; k < classes; k++)
+	{
+		int state = dfa.next[lexStart][k];
+		bool ends = dfa.stopError[state] == 0;
+		for (int j = 0; j < lexClasses; j++)
+			if (dfa.next[state][j] != lexStop) ends = false;
+		if (ends) dfa.single[k] = dfa.accept[state];
+	}
+	return dfa;
+}
+
+inline constexpr compiler::lexDfa compiler::lexTable = compiler::makeLexDfa();
+
+// mnemonics of ILL5 p-code, in the order of opCodes
+inline const compiler::shortString compiler::mnemonic[hlt + 1] = {
+	"ADD", "SUB", "MUL", "DVD", "LDI", "LDA", "LDV", "PRC", "PRS", "NLN", "PRN", "STO", "INT",
+	"EQL", "NEQ", "LSS", "LEQ", "GTR", "GEQ", "JMP", "JMZ", "SHL", "SAR", "MLI", "DVI",
+	"JEQ", "JNE", "JLT", "JLE", "JGT", "JGE", "LDX", "STX", "CHK", "CHK",
+	"LDA", "SUM", "MIN", "MAX", "FIL", "VAD", "VSB", "VML", "CPY", "RDI", "EOF", "CAL", "ENT", "RET", "LLA", "TCL", "JTB", "LOP", "JMP",
+	"LBL", "NUL", "HLT"
+};
 
 
 //*******************************************************************//
@@ -166,15 +611,45 @@ compiler::compiler(void) { prologue(); initialize(); compile(); epilogue(); }
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::getSourceFile(void)
+inline void compiler::getSourceFile(void)
 {
-	cout << "SOURCE FILE   : ";
-	do
+	// a named source is opened once; the constructor reports it if it cannot be
+	if (!sourceName.empty())
+		sourceFile.open(sourceName, ios::binary);
+	else
 	{
-		cin.getline(strBuff, 20, '\n');
-		sourceFile.open(strBuff);
+		console << "SOURCE FILE   : ";
+		do
+		{
+			cin.getline(strBuff, 20, '\n');
+			sourceFile.open(strBuff, ios::binary);
+
+		} while (!sourceFile);
+	}
+	readSource();
+}
 
-	} while (!sourceFile);
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void readSource(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::readSource(void)
+{
+	// read the whole sourceFile in one go; the lexer scans it in memory
+	sourceFile.seekg(0, ios::end);
+	streamoff size = sourceFile.tellg();
+	sourceFile.seekg(0, ios::beg);
+	source.resize(size > 0 ? (size_t)size : 0);
+	if (size > 0) sourceFile.read(&source[0], size);
+	source.resize((size_t)sourceFile.gcount());
+
+	srcPos = lineStart = source.data();
+	srcEnd = srcPos + source.size();
+	srcDone = false;
+	lineNo = 1;
 }
 
 //*******************************************************************//
@@ -184,15 +659,73 @@ void compiler::getSourceFile(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::getCodeFile(void)
+inline void compiler::getCodeFile(void)
 {
+	if (!objectName.empty()) { codeFile.open(objectName); return; }
 	do
 	{
-		cout << "OBJ-CODE FILE : H.OUT.txt";
+		console << "OBJ-CODE FILE : H.OUT.txt";
 		codeFile.open("H.OUT.txt");
 	} while (!codeFile);
 }
 
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void getListFile(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::getListFile(void)
+{
+	if (!listName.empty()) { listingFile.open(listName); return; }
+	const char *name = listJson ? "H.LST.jsonl" : "H.LST.txt";
+	do
+	{
+		console << endl << "LISTING FILE  : " << name;
+		listingFile.open(name);
+	} while (!listingFile);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void flushListing(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::flushListing(void)
+{
+	// write out the buffered listing in one piece; listMemory keeps it
+	if (listMode == listMemory) return;
+	string text = listing.str();
+	if (listMode == listConsole) console.write(text.data(), text.size());
+	else if (listMode == listFile) listingFile.write(text.data(), text.size());
+	listing.str("");
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				void jsonString(const char *s, size_t len)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::jsonString(const char *s, size_t len)
+{
+	// s as a quoted JSON string
+	static const char hex[] = "0123456789abcdef";
+	listing << '"';
+	for (size_t i = 0; i < len; i++)
+	{
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\') listing << '\\' << c;
+		else if (c < ' ') listing << "\\u00" << hex[c >> 4] << hex[c & 15];
+		else listing << c;
+	}
+	listing << '"';
+}
+
 //*******************************************************************//
 //*******************************************************************//
 //
@@ -200,9 +733,19 @@ void compiler::getCodeFile(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::prologue(void)
+inline void compiler::prologue(void)
 {
-	cout << endl << " ===  HLL6 Compiler  === " << endl << endl
+	// a compile given its source asks nothing; it does not go on when the source cannot be read
+	if (!sourceName.empty())
+	{
+		getSourceFile();
+		if (!sourceFile.is_open()) return;
+		getCodeFile();
+		if (listMode == listFile) getListFile();
+		return;
+	}
+
+	console << endl << " ===  HLL6 Compiler  === " << endl << endl
 		<< "This program accepts as input an HLL6 sentence of arthmetic expressions" << endl
 		<< "given in infix notation. It translates it into an equivalent ILL5 " << endl
 		<< "sentence of p-code instructions in postfix ordering." << endl << endl
@@ -213,6 +756,7 @@ void compiler::prologue(void)
 
 	getSourceFile();
 	getCodeFile();
+	if (listMode == listFile) getListFile();
 }
 
 //*******************************************************************//
@@ -222,59 +766,26 @@ void compiler::prologue(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::initialize(void)
+inline void compiler::initialize(void)
 {
 	bs = 8;		bell = 7;	ch = ' '; chStringLen = 0;
 
-	//list of HLL6 reserved words, listed in ascending order
-	strcpy_s(resWordList[1],  "BEGIN");
-	strcpy_s(resWordList[2],  "DECLARE");
-	strcpy_s(resWordList[3],  "DO");
-	strcpy_s(resWordList[4],  "ELSE");
-	strcpy_s(resWordList[5],  "END");
-	strcpy_s(resWordList[6],  "ENDL");
-	strcpy_s(resWordList[7],  "IF");
-	strcpy_s(resWordList[8],  "THEN");
-	strcpy_s(resWordList[9],  "WHILE");
-	strcpy_s(resWordList[10], "WRITE");
-
-	//grammar-symbol list of those reserved words
-	resSymList[1]  = beginSym;
-	resSymList[2]  = declareSym;
-	resSymList[3]  = doSym;
-	resSymList[4]  = elseSym;
-	resSymList[5]  = endSym;
-	resSymList[6]  = endlSym;
-	resSymList[7]  = ifSym;
-	resSymList[8]  = thenSym;
-	resSymList[9]  = whileSym;
-	resSymList[10] = writeSym;
-
-	// mnemonics of ILL5 p-code
-	lineLen = charCount = nextCode = 0;
-	strcpy_s(mnemonic[add], "ADD");
-	strcpy_s(mnemonic[sub], "SUB");
-	strcpy_s(mnemonic[mul], "MUL");
-	strcpy_s(mnemonic[dvd], "DVD");
-	strcpy_s(mnemonic[ldi], "LDI");
-	strcpy_s(mnemonic[lda], "LDA");
-	strcpy_s(mnemonic[ldv], "LDV");
-	strcpy_s(mnemonic[prc], "PRC");
-	strcpy_s(mnemonic[prs], "PRS");
-	strcpy_s(mnemonic[nln], "NLN");
-	strcpy_s(mnemonic[prn], "PRN");
-	strcpy_s(mnemonic[hlt], "HLT");
-	strcpy_s(mnemonic[sto], "STO");
-	strcpy_s(mnemonic[inc], "INT");
-	strcpy_s(mnemonic[eql], "EQL");
-	strcpy_s(mnemonic[neq], "NEQ");
-	strcpy_s(mnemonic[lss], "LSS");
-	strcpy_s(mnemonic[leq], "LEQ");
-	strcpy_s(mnemonic[gtr], "GTR");
-	strcpy_s(mnemonic[geq], "GEQ");
-	strcpy_s(mnemonic[jmp], "JMP");
-	strcpy_s(mnemonic[jmz], "JMZ");
-	strcpy_s(mnemonic[nul], "NUL");
+	static_assert(resWordTable.perfect, "two HLL6 reserved words share a slot of resHash()");
+	static_assert(lexTable.fits, "the lexer's DFA needs more lexStates or lexClasses");
+	symTab.assign(1, symTabRec());
+	symHash.assign(symHashMin, 0);
+
+	nextCode = 0;
+	nesting = 0;
+	caseArm = false;
+	caseSlot = 0;
+	forDepth = 0;
+	spliced = false;
+	arrayAreaSize = 0;
+	joinAt = 0;
+	scopeFrom = 0;
+	procs.clear();
+	pCode.reserve(codeChunk);
 }
 
 //*******************************************************************//
@@ -284,9 +795,11 @@ void compiler::initialize(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::epilogue(void)
+inline void compiler::epilogue(void)
 {
-	cout << endl << " === End of Compilation ===" << endl;
+	if (stream != nullptr) stream->close(false); // unless compile() has closed it
+	flushListing();
+	if (sourceName.empty()) console << endl << " === End of Compilation ===" << endl;
 	sourceFile.close(); codeFile.close(); // both not necessary
 }
 
@@ -297,40 +810,86 @@ void compiler::epilogue(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::error(int n)
+inline void compiler::error(int n)
 {
 	if (!hasError)
 	{
-		cout << endl << bell << bell << "Error " << n << ": ";
-		switch (n)
-		{
-		case 1: cout << "Number is too large."; break;
-		case 2: cout << "A \')\' is expected."; break;
-		case 3: cout << "Source incomplete, unexpected EOF."; break;
-		case 4: cout << "Unknown symbol found."; break;
-		case 5: cout << "A period is expected."; break;
-		case 6: cout << "A number, variable or \'(\' is expected."; break;
-		case 7: cout << "A variable identifier is expected."; break;
-		case 8: cout << "Assignment operator ':=' is expected."; break;
-		case 9: cout << "DECLARE expected."; break;
-		case 10: cout << "BEGIN expected."; break;
-		case 11: cout << "Whoaaaa!! Symbol table is full."; break;
-		case 12: cout << "A semicolon is expected."; break;
-		case 13: cout << "An identifier, WRITE, or ENDL is expected."; break;
-		case 14: cout << "The END is expected."; break;
-		case 15: cout << "Identifier not declared."; break;
-		case 16: cout << "Mamma mia, no re-declaration please."; break;
-		case 17: cout << "Character string is incomplete."; break;
-		case 18: cout << "Relational operator expected."; break;
-		case 19: cout << "'THEN' symbol expected."; break;
-		case 20: cout << "'DO' symbol exprected."; break;
+		int column = (int)(srcPos - lineStart);
+		if (listJson)
+		{
+			listing << "{\"kind\":\"error\",\"code\":" << n << ",\"line\":" << lineNo << ",\"column\":" << column << ",\"message\":";
+			jsonString(errorText(n), strlen(errorText(n)));
+			listing << "}\n";
 		}
+		else if (listMode != listNone)
+			listing << '\n' << bell << bell << "Error " << n << " at line " << lineNo << ", column " << column << ": "
+				<< errorText(n) << "\n\nProgram exectuion haulted.\n";
+
+		// the console always hears about an error
+		if (listMode != listConsole)
+			console << endl << bell << bell << "Error " << n << " at line " << lineNo << ", column " << column << ": "
+				<< errorText(n) << endl;
 		hasError = true;
-		cout << endl << endl << "Program exectuion haulted." << endl;
 		epilogue();
 	}
 } // error
 
+//*******************************************************************//
+//*******************************************************************//
+//
+//						const char *errorText(int n)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline const char *compiler::errorText(int n)
+{
+	switch (n)
+	{
+	case 1: return "Number is too large.";
+	case 2: return "A \')\' is expected.";
+	case 3: return "Source incomplete, unexpected EOF.";
+	case 4: return "Unknown symbol found.";
+	case 5: return "A period is expected.";
+	case 6: return "A number, variable or \'(\' is expected.";
+	case 7: return "A variable identifier is expected.";
+	case 8: return "Assignment operator ':=' is expected.";
+	case 9: return "DECLARE expected.";
+	case 10: return "BEGIN expected.";
+	case 11: return "Whoaaaa!! Symbol table is full.";
+	case 12: return "A semicolon is expected.";
+	case 13: return "An identifier, WRITE, or ENDL is expected.";
+	case 14: return "The END is expected.";
+	case 15: return "Identifier not declared.";
+	case 16: return "Mamma mia, no re-declaration please.";
+	case 17: return "Character string is incomplete.";
+	case 18: return "Relational operator expected.";
+	case 19: return "'THEN' symbol expected.";
+	case 20: return "'DO' symbol exprected.";
+	case 21: return "Program too large for the code buffer.";
+	case 22: return "Source file cannot be opened.";
+	case 23: return "Object or listing file cannot be written.";
+	case 24: return "A ']' is expected.";
+	case 25: return "Array size must be a number from 1 to 32767.";
+	case 26: return "An array must be indexed, '[' expected.";
+	case 27: return "Variable is not an array.";
+	case 28: return "Arrays must be of the same size.";
+	case 29: return "An array is expected.";
+	case 30: return "A '(' is expected.";
+	case 31: return "A ',' is expected.";
+	case 32: return "A procedure cannot be used as a variable.";
+	case 33: return "Wrong number of arguments.";
+	case 34: return "The parameters and variables of a procedure must be scalars.";
+	case 35: return "'OF' symbol expected.";
+	case 36: return "A ':' is expected.";
+	case 37: return "A CASE label must be a number.";
+	case 38: return "A CASE label may be used only once.";
+	case 39: return "'TO' symbol expected.";
+	case 40: return "The STEP of a FOR must be a number other than 0.";
+	case 41: return "The variable of a FOR must be a scalar.";
+	}
+	return "";
+}
+
 /* --------------------------------  Lexical Analyzer  --------------------------------------------- */
 
 
@@ -341,10 +900,11 @@ void compiler::error(int n)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::getSym(void)
+inline void compiler::getSym(void)
 {
 	// recognize and form next sym from sourceFile
-	while (ch == ' ') GetCh(); // skip leading blanks
+	skipBlanks();
+	symStart = srcPos - 1;
 	sym = unknownSym; // initial assumption
 	parseSymbol();
 }
@@ -356,7 +916,7 @@ void compiler::getSym(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::CGprintString(void)
+inline void compiler::CGprintString(void)
 {
 	for (int i = 0; i < chStringLen; i++)
 		gen(ldi, chStringText[i]);
@@ -371,50 +931,66 @@ void compiler::CGprintString(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::GetCh(void)
+inline void compiler::GetCh(void)
 {
-	// get next character from sourceFile
-	if (charCount == lineLen)
-	{
-		if (sourceFile.eof()) error(3);
-		lineLen = 0;
-		charCount = 0;
-		//creating the compile listing
-		sourceFile.getline(line, lineMax, '\n');
-		cout << setw(6) << nextCode << " " << line << endl;
-		while (line[lineLen++] != '\0') { /* do nothing */ }
-		line[lineLen - 1] = ' ';
-	}
-	ch = line[charCount++];
+	// get next character from source; line ends are passed on as '\n'
+	if (ch == '\n') { lineNo++; lineStart = srcPos; }
+	if (srcPos == lineStart && srcPos < srcEnd) listLine();
+	if (srcPos < srcEnd) ch = *srcPos++;
+	else if (!srcDone) { ch = ' '; srcDone = true; } // the source ends in a blank
+	else { ch = '\0'; error(3); }
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//						parseSymbol HELPLER functions
+//							void listLine(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-
-bool compiler::isDigit(void)
-{
-	if ((ch >= '0') && (ch <= '9'))
-		return true;
-	else
-		return false;
-}
-
-bool compiler::isLetter(void)
+inline void compiler::listLine(void)
 {
-	if ((ch >= 'A') && (ch <= 'Z') || (ch >= 'a' && ch <= 'z'))
-		return true;
+	// creating the compile listing, one source line at a time
+	if (listMode == listNone) return;
+	const char *end = (const char *)memchr(lineStart, '\n', srcEnd - lineStart);
+	if (end == NULL) end = srcEnd;
+	if (end > lineStart && end[-1] == '\r') end--;
+	if (listJson)
+	{
+		listing << "{\"kind\":\"line\",\"line\":" << lineNo << ",\"code\":" << nextCode << ",\"text\":";
+		jsonString(lineStart, end - lineStart);
+		listing << "}\n";
+	}
 	else
-		return false;
-
+	{
+		listing << setw(6) << nextCode << ' ';
+		listing.write(lineStart, end - lineStart);
+		listing << '\n';
+	}
 }
 
 //*******************************************************************//
 //*******************************************************************//
+//
+//							void skipBlanks(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::skipBlanks(void)
+{
+	// skip blanks, tabs and line ends; runs of blanks go eight bytes at a time
+	const unsigned long long blanks = 0x2020202020202020ULL;
+	while (ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r')
+	{
+		if (ch == ' ' && srcPos != lineStart)
+		{
+			unsigned long long word;
+			while (srcEnd - srcPos >= 8 && (memcpy(&word, srcPos, 8), word == blanks))
+				srcPos += 8;
+		}
+		GetCh();
+	}
+}
 
 //*******************************************************************//
 //*******************************************************************//
@@ -423,107 +999,90 @@ bool compiler::isLetter(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::parseSymbol(void)
+inline void compiler::parseSymbol(void)
 {
-	int i, j, k;
-
-	switch (ch)
+	// Identifiers, numbers and strings are taken by loops of their own, and so is a symbol of one
+	// character. Inside a symbol there are no line ends, so characters are read straight from the
+	// source; only the character after a symbol goes through GetCh(), for the end of the source.
+	int k = srcDone ? (int)endClass : (int)lexTable.charClass[(unsigned char)ch];
+	const char *pos = srcPos;
+	char c = ch;
+	if (k == letterClass)
 	{
-	case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
-	case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y': case 'z':
-	case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I': case 'J': case 'K': case 'L': case 'M': case 'N': case 'O': case 'P':
-	case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
-		k = 0;
-		for (int count = 0; count < wLeng; count++)
-			id[count] = '\0';
-
-		do  //Check: check for correct logic
-		{
-			if ((ch >= 'a') && (ch <= 'z'))
-				ch -= 32;
-			if (k <= wLeng)
-			{
-				id[k] = ch;
-				k++;
-			}
-			GetCh();
-		} while (isLetter() || isDigit());
-		i = 1; //Index counter of the reserved words list (index of the first word)
-		j = resWords;
-		do
+		id.clear();
+		idHash = 2166136261u; // FNV-1a
+		for (;;)
 		{
-			k = (i + j) / 2;
-			if (strcmp(id, resWordList[k]) < 0 || strcmp(id, resWordList[k]) == 0)
-				j = k - 1;
-			if (strcmp(id, resWordList[k]) > 0 || strcmp(id, resWordList[k]) == 0)
-				i = k + 1;
-		} while (i <= j);
-		if ((i - 1) > j)
-			sym = resSymList[k];
-		else
-			sym = varIdentSym;
-		break;
+			if (c >= 'a' && c <= 'z') c -= 32;
+			id += c;
+			idHash = (idHash ^ (unsigned char)c) * 16777619u;
+			if (pos == srcEnd) { srcPos = pos; GetCh(); break; }	// the source ends in the identifier
+			c = *pos++;
+			k = lexTable.charClass[(unsigned char)c];
+			if (k != letterClass && k != digitClass) { srcPos = pos; ch = c; break; }
+		}
 
-	case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7':
-	case '8': case '9': //If it is a number, go through the "do while" loop below
+		// a reserved word can only be the one word in its hash slot
+		const resWordRec &word = resWordTable.slot[resHash(id.c_str(), (int)id.size())];
+		sym = (word.name != nullptr && word.len == (int)id.size() && id == word.name) ? word.sym : varIdentSym;
+	}
+	else if (k == digitClass)
+	{
 		number = 0;
-		sym = numberSym;
-		do
+		for (;;)
 		{
-			if (number <= (MaxInt - (ch - '0')) / 10) // overflow?
-				number = 10 * number + (ch - '0');
+			if (number <= (MaxInt - (c - '0')) / 10) // overflow?
+				number = 10 * number + (c - '0');
 			else
+			{
+				srcPos = pos;
 				error(1);
-
-			GetCh();
-		} while (ch <= '9' && ch >= '0');
-		break;
-
-	case '*': sym = timesSym;			GetCh();  break;
-	case '/': sym = slashSym;			GetCh();  break;
-	case '+': sym = plusSym;			GetCh();  break;
-	case '-': sym = minusSym;			GetCh();  break;
-	case '(': sym = leftParenSym;		GetCh();  break;
-	case ')': sym = rightParenSym;		GetCh();  break;
-	case ';': sym = semicolonSym;		GetCh();  break;
-	case '.': sym = periodSym;			GetCh();  break;
-	case ',': sym = commaSym;			GetCh();  break;
-	case '"': case '\'':
-	{
-		char startChar = ch; chStringLen = 0;
+			}
+			if (pos == srcEnd) { srcPos = pos; GetCh(); break; }	// the source ends in the number
+			c = *pos++;
+			if (lexTable.charClass[(unsigned char)c] != digitClass) { srcPos = pos; ch = c; break; }
+		}
+		sym = numberSym;
+	}
+	else if (k == dQuoteClass || k == sQuoteClass)
+	{
+		// <charString>, closed by the quote it opens with before the line or the source ends
+		while (pos < srcEnd && *pos != c && *pos != '\n' && *pos != '\r')
+			pos++;
+		chStringText.assign(srcPos, pos - srcPos);
+		chStringLen = (int)chStringText.size();
+		sym = stringSym;
+		bool closed = pos < srcEnd && *pos == c;
+		srcPos = closed ? pos + 1 : pos;
 		GetCh();
-		while (ch != startChar)
+		if (!closed)
 		{
-			chStringText[chStringLen] = ch;
-			chStringLen++;
+			error(17);
 			GetCh();
-			if (chStringLen > lineMax)
-				error(17);
 		}
-		GetCh();
-		sym = stringSym;
-		break;
 	}
-	case ':': GetCh();
-		if (ch == '=') sym = assignSym;
-		else error(8);
-		GetCh(); break;
-	case '<': GetCh();
-		if (ch == '=') { sym = leqSym; GetCh(); }
-		else             sym = lessSym;
-		break;
-	case '=': sym = eqlSym; GetCh();
-		break;
-	case '#': sym = neqSym; GetCh();
-		break;
-	case '>': GetCh();
-		if (ch == '=') { sym = geqSym; GetCh(); }
-		else		     sym = gtrSym;
-		break;
-	default:
+	else if (lexTable.single[k] != unknownSym)
 	{
-		GetCh();	error(4);
+		sym = lexTable.single[k];
+		GetCh();
 	}
+	else
+	{
+		// the DFA spells out a fixed symbol of more characters, or takes a character that starts none
+		int state = lexTable.next[lexStart][k], next;
+		while (pos < srcEnd && (next = lexTable.next[state][lexTable.charClass[(unsigned char)*pos]]) != lexStop)
+		{
+			state = next;
+			pos++;
+		}
+		srcPos = pos;
+		GetCh();
+		sym = lexTable.accept[state];
+		if (lexTable.stopError[state] != 0)
+		{
+			error(lexTable.stopError[state]);
+			if (lexTable.skipAfter[state]) GetCh();
+		}
 	}
 } // parseSymbol
 
@@ -536,444 +1095,1971 @@ void compiler::parseSymbol(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::compile(void)
+inline void compiler::compile(void)
 {
-	// <HLL6-sentence> -> <varDeclaration> <vainProgSection> '.'
-	cout << endl << "  Compile Listing:  " << endl;
-	lastEntry = 0;
-	varDeclaration();
-	CGincrementStack(lastEntry);
-	mainProgSection();
+	// <HLL6-sentence> -> <varDeclaration> { <procDeclaration> } <vainProgSection> '.'
+	// the procedures are jumped over to the main program
+	if (listText()) listing << "\n  Compile Listing:  \n";
+	if (!resumeIncremental())
+	{
+		lastEntry = 0;
+		varDeclaration();
+		varAreaLoc = nextCode;
+		varAreaSize = lastEntry;
+		CGincrementStack(lastEntry + arrayAreaSize);
+		if (sym == procedureSym)
+		{
+			int mainLabel = nextCode;
+			CGJump(-1);
+			while (sym == procedureSym && !hasError)
+				procDeclaration();
+			backPatch(mainLabel, nextCode);
+		}
+		mainProgSection();
+	}
+	else
+	{
+		statementSequence();
+		if (!spliced) accept(endSym, 14);
+	}
 
-	if (sym != periodSym)
+	if (!spliced && sym != periodSym)
 		error(5);
 	else
 	{ 
-		CGHalt();
+		if (!spliced) CGHalt();
+		if (!hasError && incremental == nullptr && stream == nullptr) optimize();
+		if (stream != nullptr) { publishCode(); stream->close(!hasError); }
 		printSymTab();
 		dumpCode();
+		if (incremental != nullptr) keepIncremental();
 	}
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void enter(void)
+//						bool resumeIncremental(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::enter(void)
+inline bool compiler::resumeIncremental(void)
 {
-	int i;
-
-	if (lastEntry == tableMax)
-		error(11);
-	for (i = 1; i <= lastEntry; i++)
-		if (strcmp(symTab[i].name, id) == 0)
-			error(16);
-
-	lastEntry++;
-	strcpy(symTab[lastEntry].name, id);
-	symTab[lastEntry].address = lastEntry;
+	// Compare the source with the last one. Top-level statements before the first change keep
+	// their code where it is, and parsing resumes with the first statement that may have changed.
+	// A statement after the last change whose preceding ';' is on an unchanged line is parsed
+	// the same way as before, so once parsing reaches it the rest of the old code is spliced in.
+	spliced = false;
+	nesting = 0;
+	stats.clear();
+	spliceAt.clear();
+	if (incremental == nullptr || !incremental->valid) return false;
+	incrementalState &old = *incremental;
+	old.valid = false;
+
+	const string &was = old.source;
+	size_t common = min(was.size(), source.size());
+	size_t same = mismatch(was.begin(), was.begin() + common, source.begin()).first - was.begin();
+	size_t sameEnd = 0;
+	while (sameEnd < common - same && was[was.size() - 1 - sameEnd] == source[source.size() - 1 - sameEnd])
+		sameEnd++;
+	if (old.stats.empty() || (size_t)old.stats[0].start > same)
+		return false; // the declarations or BEGIN changed
+
+	size_t first = 0;
+	while (first + 1 < old.stats.size() && (size_t)old.stats[first + 1].start <= same)
+		first++;
+	int delta = (int)source.size() - (int)was.size();
+	for (size_t j = old.stats.size() - 1; j > first && (size_t)old.stats[j].lineStart >= was.size() - sameEnd; j--)
+		spliceAt[old.stats[j].start + delta] = (int)j;
+
+	// take over the declarations and the code before statement first
+	symTab.swap(old.symTab);
+	symHash.swap(old.symHash);
+	procs.swap(old.procs);
+	lastEntry = old.lastEntry;
+	varAreaLoc = old.varAreaLoc;
+	varAreaSize = lastEntry;
+	arrayAreaSize = old.arrayAreaSize;
+	pCode.assign(old.code.begin(), old.code.begin() + old.stats[first].codeFrom);
+	nextCode = old.stats[first].codeFrom;
+	joinAt = nextCode;	// the old code may jump here
+	stats.assign(old.stats.begin(), old.stats.begin() + first);
+
+	// and put the lexer where it was before that statement
+	const statementRec &from = old.stats[first];
+	srcPos = source.data() + from.start;
+	lineStart = source.data() + from.lineStart;
+	lineNo = from.line;
+	ch = srcPos[-1];
+	if (ch != '\n') listLine();
+
+	if (listJson)
+		listing << "{\"kind\":\"incremental\",\"kept\":" << first << ",\"from\":" << from.line << "}\n";
+	else if (listMode != listNone)
+		listing << setw(6) << "" << " " << first << " statements kept, reparsing from line " << from.line << '\n';
+	return true;
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//						void searchIdLoc(int &idEntry)
+//						bool spliceStatements(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::searchIdLoc(int &idEntry)
+inline bool compiler::spliceStatements(void)
 {
-	strcpy(symTab[0].name, id);
-	idEntry = lastEntry + 1;
-	do
-		idEntry--;
-	while (strcmp(symTab[idEntry].name, id) != 0);
+	// at a top-level ';' where an unchanged old statement follows, append the old code
+	// from there on, jumps relocated, and stop parsing
+	unordered_map<int, int>::iterator it = spliceAt.find((int)(srcPos - source.data()));
+	if (it == spliceAt.end()) return false;
+
+	const incrementalState &old = *incremental;
+	const statementRec &next = old.stats[it->second];
+	int codeDelta = nextCode - next.codeFrom;
+	int srcDelta = (int)source.size() - (int)old.source.size();
+	int lineDelta = lineNo - next.line;
+	if (nextCode + (int)old.code.size() - next.codeFrom > codeLimit)
+	{
+		error(21);
+		return false;
+	}
+	pCode.insert(pCode.end(), old.code.begin() + next.codeFrom, old.code.end());
+	for (; nextCode < (int)pCode.size(); nextCode++)
+		if (isJump(pCode[nextCode].op) && !isCall(pCode[nextCode].op)) pCode[nextCode].arg += codeDelta;
+	for (size_t j = it->second; j < old.stats.size(); j++)
+	{
+		statementRec rec = old.stats[j];
+		rec.start += srcDelta; rec.lineStart += srcDelta; rec.line += lineDelta; rec.codeFrom += codeDelta;
+		stats.push_back(rec);
+	}
 
-	if (idEntry == 0) error(15);
+	if (listJson)
+		listing << "{\"kind\":\"incremental\",\"reused\":" << old.stats.size() - it->second << ",\"from\":" << lineNo << "}\n";
+	else if (listMode != listNone)
+		listing << setw(6) << "" << " " << old.stats.size() - it->second << " statements reused from line " << lineNo << '\n';
+	spliced = true;
+	return true;
 }
 
-
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void accept(void)
+//						void keepIncremental(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::accept(symbols expected, int errorNum)
+inline void compiler::keepIncremental(void)
 {
-	if (sym == expected)
-		getSym();
-	else
-		error(errorNum);
+	// remember this compile for the next one
+	incrementalState &keep = *incremental;
+	keep.valid = !hasError;
+	if (hasError) return;
+	keep.source.swap(source);
+	keep.code.swap(pCode);
+	keep.stats.swap(stats);
+	keep.symTab.swap(symTab);
+	keep.symHash.swap(symHash);
+	keep.procs.swap(procs);
+	keep.lastEntry = lastEntry;
+	keep.varAreaLoc = varAreaLoc;
+	keep.arrayAreaSize = arrayAreaSize;
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void assignStat(void)
+//							void enter(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::assignStat(void)
+inline void compiler::enter(void)
 {
-	// <i-assignStat> -> <varIdent> '=' <i-expression>
-	int varIdLoc;
+	int slot = findSymSlot();
 
-	searchIdLoc(varIdLoc);
-	if (varIdLoc > tableMax) error(11);
-	CGloadAddress(varIdLoc);
-	getSym();
-	accept(assignSym, 8);
-	expression();
-	CGassignment();
+	if (lastEntry == MaxInt)
+		error(11);
+	if (symHash[slot] != 0)
+	{
+		error(16);
+		return;
+	}
+
+	lastEntry++;
+	symTab.push_back({ id, lastEntry, idHash, 0, globalKind });
+	symHash[slot] = lastEntry;
+	if (2 * lastEntry > (int)symHash.size()) growSymHash();
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void writeStat(void)
+//				void enterLocal(symKinds kind, int address)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::writeStat(void)
+inline void compiler::enterLocal(symKinds kind, int address)
 {
-	// <writeStat>  -> 'WRITE' <writeParam> | 'ENDL'
-	// <writeParam> ->  <varIdent> | <number> | <charString>
-	int loc = 0;
-
-	getSym();
-	switch (sym)
+	// a procedure, or a parameter or variable of the one being compiled; these may hide a
+	// global of the same name, but not one another
+	int slot = findSymSlot();
+	if (symHash[slot] != 0 && (kind == procKind || symHash[slot] >= scopeFrom))
 	{
-	case numberSym:
-		CGloadConstant(number);
-		CGprintNumOp(); break;
-	case varIdentSym:
-		searchIdLoc(loc);
-		if (loc > tableMax) error(11);
-		CGloadAddress(loc);
-		CGdereference();
-		CGprintNumOp();
-		break;
-	case stringSym:
-		CGprintString();
-		break;
-	case endlSym:
-		CGdoCRLF();
-		break;
+		error(16);
+		return;
 	}
-	getSym();
+	symTab.push_back({ id, address, idHash, 0, kind });
+	symHash[slot] = (int)symTab.size() - 1;
+	if (2 * (int)symTab.size() > (int)symHash.size()) growSymHash();
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void condition(void)
+//							void leaveScope(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::condition(void)
+inline void compiler::leaveScope(void)
 {
-	//<condition> -> <i-expression> <relOp> <i-expression>
-	expression();
-	switch (sym)
+	// the parameters and variables of a procedure are forgotten at its end
+	symTab.resize(scopeFrom);
+	scopeFrom = 0;
+	hashSymbols();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							int findSymSlot(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::findSymSlot(void)
+{
+	// the slot of symHash holding id, or the empty slot where it belongs
+	int mask = (int)symHash.size() - 1;
+	int slot = idHash & mask;
+	while (symHash[slot] != 0)
 	{
-	case eqlSym:  getSym(); expression(); CGrelOp(eql); break;
-	case neqSym:  getSym(); expression(); CGrelOp(neq); break;
-	case lessSym: getSym(); expression(); CGrelOp(lss); break;
-	case leqSym:  getSym(); expression(); CGrelOp(leq); break;
-	case gtrSym:  getSym(); expression(); CGrelOp(gtr); break;
-	case geqSym:  getSym(); expression(); CGrelOp(geq); break;
-	default:
-		error(18);
+		const symTabRec &rec = symTab[symHash[slot]];
+		if (rec.hash == idHash && rec.name == id) break;
+		slot = (slot + 1) & mask;
 	}
+	return slot;
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void ifStat(void)
+//							void growSymHash(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::ifStat(void)
+inline void compiler::growSymHash(void)
 {
-	// <ifStat> -> 'IF' <condition> 'THEN' <statSequence> ['ELSE' <statSequence>] 'END'
-	int jmzLabel, jmpLabel;
-	getSym();
-	condition();
-	jmzLabel = nextCode;
-	CGjumpOnFalse(-1);
-	if (sym != thenSym) error(19);
-	statementSequence();
-	if (sym == elseSym)
+	// double the slots, keeping the table at most half full
+	symHash.assign(2 * symHash.size(), 0);
+	hashSymbols();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void hashSymbols(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::hashSymbols(void)
+{
+	// every entry of symTab, in order, so that a local takes the slot of a global it hides
+	int mask = (int)symHash.size() - 1;
+	fill(symHash.begin(), symHash.end(), 0);
+	for (int i = 1; i < (int)symTab.size(); i++)
 	{
-		jmpLabel = nextCode;
-		CGJump(-1);
-		backPatch(jmzLabel, nextCode);
-		statementSequence();
-		backPatch(jmpLabel, nextCode);
+		int slot = symTab[i].hash & mask;
+		while (symHash[slot] != 0 && symTab[symHash[slot]].name != symTab[i].name) slot = (slot + 1) & mask;
+		symHash[slot] = i;
 	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void searchIdLoc(int &idEntry)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::searchIdLoc(int &idEntry)
+{
+	idEntry = symHash[findSymSlot()];
+	if (idEntry == 0) error(15);
+	else if (symTab[idEntry].kind == procKind) error(32);
+}
+
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void accept(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::accept(symbols expected, int errorNum)
+{
+	if (sym == expected)
+		getSym();
 	else
-		backPatch(jmzLabel, nextCode);
-	accept(endSym, 14);
+		error(errorNum);
 }
+
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void whileStat(void)
+//							void assignStat(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::whileStat(void)
+inline void compiler::assignStat(void)
 {
-	//<whileStat> -> 'WHILE' <condition> 'DO' <statSequence> 'END'
-	int startLabel, endLabel;
-	startLabel = nextCode;
+	// <i-assignStat> -> <variable> '=' <i-expression>
+	int varIdLoc;
+
+	searchIdLoc(varIdLoc);
+	if (symTab[varIdLoc].size > 0)
+	{
+		getSym();
+		if (sym == assignSym)
+		{
+			arrayAssignStat(varIdLoc);
+			return;
+		}
+		indexExpression(varIdLoc);
+		accept(assignSym, 8);
+		expression();
+		CGstoreElement(symTab[varIdLoc].address);
+		return;
+	}
+	CGloadVariable(varIdLoc);
 	getSym();
-	condition();
-	endLabel = nextCode;
-	CGjumpOnFalse(-1);
-	if (sym != doSym) error(20);
-	statementSequence();
-	CGJump(startLabel);
-	backPatch(endLabel, nextCode);
-	accept(endSym, 14);
+	if (sym == leftBracketSym) error(27);
+	accept(assignSym, 8);
+	expression();
+	CGassignment();
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void backPatch(void)
+//							void writeStat(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::backPatch(int loc, int arg)
+inline void compiler::writeStat(void)
 {
-	pCode[loc].arg = arg;
+	// <writeStat>  -> 'WRITE' <writeParam> | 'ENDL'
+	// <writeParam> ->  <variable> | <number> | <charString>
+	int loc = 0;
+
+	getSym();
+	switch (sym)
+	{
+	case numberSym:
+		CGloadConstant(number);
+		CGprintNumOp(); break;
+	case varIdentSym:
+		searchIdLoc(loc);
+		if (symTab[loc].size > 0)
+		{
+			getSym();
+			indexExpression(loc);
+			CGloadElement(symTab[loc].address);
+			CGprintNumOp();
+			return;
+		}
+		CGloadVariable(loc);
+		CGdereference();
+		CGprintNumOp();
+		break;
+	case stringSym:
+		CGprintString();
+		break;
+	case endlSym:
+		CGdoCRLF();
+		break;
+	}
+	getSym();
+	if (loc != 0 && sym == leftBracketSym) error(27);
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void statement(void)
+//							void readStat(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::statement(void)
+inline void compiler::readStat(void)
 {
-	// <statement> -> <i-assignStat> | <writeStat> | <ifStat> | <whileStat>
-	switch (sym)
+	// <readStat> -> 'READ' <variable>
+	int loc = 0;
+
+	getSym();
+	if (sym != varIdentSym) error(7);
+	else searchIdLoc(loc);
+	if (symTab[loc].size > 0)
 	{
-	case varIdentSym: assignStat(); break;
-	case writeSym:    writeStat(); break;
-	case endlSym:     CGdoCRLF(); getSym();  break;
-	case ifSym:		  ifStat();  break;
-	case whileSym:    whileStat();
+		getSym();
+		indexExpression(loc);
+		CGread();
+		CGstoreElement(symTab[loc].address);
+		return;
 	}
+	CGloadVariable(loc);
+	CGread();
+	CGassignment();
+	getSym();
+	if (sym == leftBracketSym) error(27);
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//						void statementSequence(void)
+//					void arrayAssignStat(int arrayEntry)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::statementSequence(void)
+inline void compiler::arrayAssignStat(int arrayEntry)
 {
-	// <statSequence> -> <statement> { ';' <statement> }
-	do
+	// <a-assignStat> -> <varIdent> ':=' <varIdent> [ ('+' | '-' | '*') <varIdent> ]
+	// a single CPY, or VAD, VSB or VML, over the whole of the arrays
+	int size = symTab[arrayEntry].size;
+	CGloadBase(symTab[arrayEntry].address);
+	getSym();
+	arrayOperand(size);
+	if (sym == plusSym || sym == minusSym || sym == timesSym)
 	{
+		opCodes op = sym == plusSym ? vad : sym == minusSym ? vsb : vml;
 		getSym();
-		if ((sym == varIdentSym) || (sym == writeSym) || (sym == endlSym) || (sym == ifSym) || (sym == whileSym))
-			statement();
-		else
-			error(13);
-	} while (sym == semicolonSym);
+		arrayOperand(size);
+		CGbulkOp(op, size);
+	}
+	else
+		CGbulkOp(vcp, size);
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//						void mainProgSection(void)
+//						int arrayOperand(int size)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::mainProgSection(void)
+inline int compiler::arrayOperand(int size)
 {
-	// <mainProgSection> -> 'BEGIN' <statSequence> 'END'
-	if (sym != beginSym)
-		error(10);
-	statementSequence();
-	accept(endSym, 14);
+	// an array named without an index, of the given size unless that is 0; where it starts is
+	// pushed and its size returned
+	int loc = 0;
+	if (sym != varIdentSym) error(29);
+	else searchIdLoc(loc);
+	if (symTab[loc].size == 0) error(29);
+	else if (size > 0 && symTab[loc].size != size) error(28);
+	CGloadBase(symTab[loc].address);
+	getSym();
+	return symTab[loc].size;
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//						void varDeclaration(void)
+//							void fillStat(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::varDeclaration(void)
+inline void compiler::fillStat(void)
 {
-	// <varDeclaration> -> 'DECLARE' <varIdent> { ',' <varIdent> } ';'
+	// <fillStat> -> 'FILL' '(' <varIdent> ',' <i-expression> ')'
 	getSym();
-	if (sym != declareSym)
-		error(9);
-	do
+	accept(leftParenSym, 30);
+	int size = arrayOperand(0);
+	accept(commaSym, 31);
+	expression();
+	CGbulkOp(vfl, size);
+	accept(rightParenSym, 2);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void condition(condRec &c)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::condition(condRec &c)
+{
+	// <condition> -> <conjunction> { 'OR' <conjunction> }
+	// its code falls through when the condition is true, and the jumps left in c.onFalse are
+	// taken when it is false
+	negation(c);
+	conjunction(c);
+	disjunction(c);
+	if (!c.fallsTrue) flipJump(c);
+	backPatch(c.onTrue, nextCode);
+	c.onTrue.clear();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void negation(condRec &c)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::negation(condRec &c)
+{
+	// <negation> -> 'NOT' <negation> | '(' <condition> ')' | <i-expression> <relOp> <i-expression>
+	// a NOT generates no code, it swaps the jumps taken when true and when false. The '(' before
+	// a relation are handed to expression(), which gives back those that group the condition
+	int groups = 0;
+	while (sym == leftParenSym)
 	{
+		groups++;
 		getSym();
-		if (sym != varIdentSym)
-			error(7);
-		else
+	}
+	if (sym == notSym)
+	{
+		getSym();
+		negation(c);
+		swap(c.onTrue, c.onFalse);
+		c.fallsTrue = !c.fallsTrue;
+	}
+	else
+	{
+		// the relation is left to the jump that follows, which compares and branches at once
+		groups = expression(groups);
+		condRight = nextCode;
+		switch (sym)
 		{
-			enter();
-			getSym();
+		case eqlSym:  getSym(); expression(); condOp = eql; break;
+		case neqSym:  getSym(); expression(); condOp = neq; break;
+		case lessSym: getSym(); expression(); condOp = lss; break;
+		case leqSym:  getSym(); expression(); condOp = leq; break;
+		case gtrSym:  getSym(); expression(); condOp = gtr; break;
+		case geqSym:  getSym(); expression(); condOp = geq; break;
+		default:
+			error(18);
 		}
-	} while (sym == commaSym);
-	accept(semicolonSym, 12);
+		c.onFalse.push_back(nextCode);
+		CGjumpOnFalse(-1);
+	}
+	for (; groups > 0; groups--)
+	{
+		conjunction(c);
+		disjunction(c);
+		accept(rightParenSym, 2);
+	}
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//						void printSymTab(void)
+//							void conjunction(condRec &c)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::printSymTab(void)
+inline void compiler::conjunction(condRec &c)
 {
-	int i;
-	cout << endl;
-	cout << "Symbol Table:" << endl;
-	cout << " No.   VarName     VarAddress" << endl;
-	for (i = 1; i <= lastEntry; i++)
+	// { 'AND' <negation> } after the <negation> in c: a left operand that is false skips the rest
+	while (sym == andSym)
 	{
-		int w = wLeng - strlen(symTab[i].name);
-		cout << "  " << i << "     " << symTab[i].name;
-		for (int count = 0; count < w; count++)
-			cout << " ";
-		cout << "       " << symTab[i].address << endl;
+		condRec right;
+		getSym();
+		if (!c.fallsTrue) flipJump(c);
+		backPatch(c.onTrue, nextCode);
+		negation(right);
+		c.onTrue = right.onTrue;
+		c.onFalse.insert(c.onFalse.end(), right.onFalse.begin(), right.onFalse.end());
+		c.fallsTrue = right.fallsTrue;
+		c.compound = true;
 	}
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void expression(void)
+//							void disjunction(condRec &c)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::expression(void)
+inline void compiler::disjunction(condRec &c)
 {
-	// <i-expression> -> <term> { ('+' | '-') <term> }
-	symbols addOp;
-	term();
-	while (sym == plusSym || sym == minusSym)
+	// { 'OR' <conjunction> } after the <conjunction> in c: a left operand that is true skips the rest
+	while (sym == orSym)
 	{
-		addOp = sym;
+		condRec right;
 		getSym();
-		term();
-		CGbinaryIntOp(addOp);
+		if (c.fallsTrue) flipJump(c);
+		backPatch(c.onFalse, nextCode);
+		negation(right);
+		conjunction(right);
+		c.onFalse = right.onFalse;
+		c.onTrue.insert(c.onTrue.end(), right.onTrue.begin(), right.onTrue.end());
+		c.fallsTrue = right.fallsTrue;
+		c.compound = true;
 	}
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void term(void)
+//							void flipJump(condRec &c)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::flipJump(condRec &c)
+{
+	// the last jump of c, which tests the last relation, is made to branch on the other outcome,
+	// so the code falls through the other way
+	vector<int> &from = c.fallsTrue ? c.onFalse : c.onTrue, &to = c.fallsTrue ? c.onTrue : c.onFalse;
+	condOp = complement(condOp);
+	pCode[from.back()].op = branchOn(condOp, false);
+	to.push_back(from.back());
+	from.pop_back();
+	c.fallsTrue = !c.fallsTrue;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				opCodes branchOn(opCodes relOp, bool outcome)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::term(void)
+inline compiler::opCodes compiler::branchOn(opCodes relOp, bool outcome)
 {
-	// <term> -> <factor> { ('*' | '/') <factor> }
-	symbols mulOp;
-	factor();
-	while (sym == timesSym || sym == slashSym)
+	// compare-and-branch taken when relOp has the given outcome
+	switch (relOp)
 	{
-		mulOp = sym;
-		getSym();
-		factor();
-		CGbinaryIntOp(mulOp);
+	case eql: return outcome ? jeq : jne;
+	case neq: return outcome ? jne : jeq;
+	case lss: return outcome ? jlt : jge;
+	case leq: return outcome ? jle : jgt;
+	case gtr: return outcome ? jgt : jle;
+	default:  return outcome ? jge : jlt;
 	}
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//							void factor(void)
+//					opCodes complement(opCodes relOp)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::factor(void)
+inline compiler::opCodes compiler::complement(opCodes relOp)
 {
-	// <factor> -> <number> | <varIdent> | '(' <i-expression> ')'
-	int varIdLoc = 0;
-	switch (sym)
+	// the relation that holds exactly when relOp does not
+	switch (relOp)
 	{
-	case varIdentSym:
-		searchIdLoc(varIdLoc);
-		if (varIdLoc > tableMax) error(11);
-		CGloadAddress(varIdLoc);
-		CGdereference();
-		getSym(); break;
-	case leftParenSym:
-		getSym();	expression();	accept(rightParenSym, 2);	break;
-	case numberSym:
-		CGloadConstant(number);	getSym();	break;
-	default: error(6);
+	case eql: return neq;
+	case neq: return eql;
+	case lss: return geq;
+	case leq: return gtr;
+	case gtr: return leq;
+	default:  return lss;
 	}
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//						void gen(opCodes op, int arg)
+//							void ifStat(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::gen(opCodes op, int arg)
+inline void compiler::ifStat(void)
 {
-	pCode[nextCode].op = op;
-	pCode[nextCode].arg = arg;
-	nextCode++;
+	// <ifStat> -> 'IF' <condition> 'THEN' <statSequence> ['ELSE' <statSequence>] 'END'
+	condRec c;
+	int jmpLabel;
+	getSym();
+	condition(c);
+	if (sym != thenSym) error(19);
+	statementSequence();
+	if (sym == elseSym)
+	{
+		jmpLabel = nextCode;
+		CGJump(-1);
+		backPatch(c.onFalse, nextCode);
+		statementSequence();
+		backPatch(jmpLabel, nextCode);
+	}
+	else
+		backPatch(c.onFalse, nextCode);
+	accept(endSym, 14);
+}
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void whileStat(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::whileStat(void)
+{
+	//<whileStat> -> 'WHILE' <condition> 'DO' <statSequence> 'END'
+	// The loop is rotated: the condition is tested before the loop and again after each
+	// iteration, so an iteration takes a single branch. A counted loop is also unrolled,
+	// and the indexes it proves in range are not checked. The test after an iteration is a copy
+	// of the one before the loop whose last jump goes back to the body when true.
+	condRec c;
+	int startLabel, endLabel, rightStart, bodyStart, copied, var, step;
+	bool joined, counted, unrolled = false;
+	opCodes relOp;
+	startLabel = nextCode;
+	joined = joinAt == startLabel;
+	getSym();
+	condition(c);
+	relOp = condOp;
+	rightStart = condRight;
+	endLabel = nextCode - 1;
+	if (sym != doSym) error(20);
+	bodyStart = nextCode;
+	statementSequence();
+	if (!hasError && !c.compound)
+	{
+		unrolled = countedLoop(startLabel, rightStart, endLabel, bodyStart, nextCode, relOp, var, step, counted);
+		if (counted && !joined) proveIndexes(startLabel, rightStart, endLabel, bodyStart, nextCode - 6, relOp, var);
+	}
+	if (unrolled)
+		unrollLoop(rightStart, endLabel, bodyStart, nextCode, relOp, var, step);
+	else
+	{
+		copied = nextCode;
+		copyCode(startLabel, endLabel);
+		gen(branchOn(relOp, true), bodyStart);
+		for (int i = 0, n = (int)c.onFalse.size() - 1; i < n; i++)
+			c.onFalse.push_back(c.onFalse[i] + copied - startLabel);
+	}
+	backPatch(c.onFalse, nextCode);
+	accept(endSym, 14);
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//						void dumpCode(void)
+//							void forStat(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::dumpCode(void)
+inline void compiler::forStat(void)
 {
-	for (int i = 0; i < nextCode; i++)
+	// <forStat> -> 'FOR' <varIdent> ':=' <i-expression> 'TO' <i-expression> [ 'STEP' [ '-' ] <number> ] 'DO'
+	//              <statSequence> 'END'
+	// The limit is computed before the variable is set, into a slot of its own: a temporary, or
+	// a variable of the frame, when the code is optimized, and the top of the stack, where it
+	// stays until the loop ends, when it is not. The loop is tested once before it is entered;
+	// after each iteration a LOP steps the variable, compares it and jumps back.
+	pInstruction counter, limit;
+	int varIdLoc, from = nextCode, mid, guard, bodyStart, step = 1;
+	bool onStack = incremental != nullptr || stream != nullptr;
+	getSym();
+	if (sym != varIdentSym) error(7);
+	searchIdLoc(varIdLoc);
+	if (symTab[varIdLoc].size > 0) error(41);
+	CGloadVariable(varIdLoc);
+	counter = pCode[from];
+	getSym();
+	accept(assignSym, 8);
+	expression();
+	CGassignment();
+	accept(toSym, 39);
+	mid = nextCode;
+	if (onStack)
 	{
-		codeFile << setw(10) << i << setw(5) << mnemonic[pCode[i].op];
-		if (pCode[i].op == ldi || pCode[i].op == inc || pCode[i].op == lda || pCode[i].op == jmp || pCode[i].op == jmz)
-			codeFile << setw(5) << pCode[i].arg << endl;
-		else
-			codeFile << endl;
+		forDepth++;
+		limit = scopeFrom != 0 ? pInstruction{ lla, procs.back().locals + forDepth } : pInstruction{ lda, lastEntry + arrayAreaSize + forDepth };
+		expression();
+	}
+	else
+	{
+		limit = scopeFrom != 0 ? pInstruction{ lla, ++procs.back().locals } : pInstruction{ lda, ++varAreaSize };
+		gen(limit.op, limit.arg);
+		expression();
+		CGassignment();
+	}
+	moveCode(from, mid, nextCode);
+	if (sym == stepSym)
+	{
+		getSym();
+		if (sym == minusSym)
+		{
+			step = -1;
+			getSym();
+		}
+		if (sym != numberSym || number == 0) error(40);
+		step *= number;
+		getSym();
 	}
+
+	gen(counter.op, counter.arg);
+	CGdereference();
+	gen(limit.op, limit.arg);
+	CGdereference();
+	guard = nextCode;
+	gen(step > 0 ? jgt : jlt, -1);
+	if (sym != doSym) error(20);
+	bodyStart = nextCode;
+	statementSequence();
+	gen(lop, bodyStart);
+	gen(counter.op, counter.arg);
+	gen(limit.op, limit.arg);
+	CGloadConstant(step);
+	backPatch(guard, nextCode);
+	if (onStack)
+	{
+		CGincrementStack(-1);
+		forDepth--;
+	}
+	accept(endSym, 14);
 }
 
 //*******************************************************************//
 //*******************************************************************//
 //
-//					void CGBinaryIntOp(symbols op)
+//	bool countedLoop(int condStart, int rightStart, int guard, int bodyStart, int bodyEnd,
+//					 opCodes relOp, int &var, int &step, bool &counted)
 //
 //*******************************************************************//
 //*******************************************************************//
-void compiler::CGbinaryIntOp(symbols op)
+inline bool compiler::countedLoop(int condStart, int rightStart, int guard, int bodyStart, int bodyEnd, opCodes relOp, int &var, int &step, bool &counted)
 {
-	switch (op)
+	// WHILE i <= b DO ... i := i + c END (or i < b) where the body ends with the only change
+	// of i, c is a positive literal and b does not change in the body; whether it is unrolled
+	// is listed
+	const char *reason = NULL, *shape = NULL;
+	int incr = bodyEnd - 6;
+	var = pCode[condStart].arg;
+	step = incr >= bodyStart ? pCode[incr + 3].arg : 0;
+
+	if ((relOp != leq && relOp != lss) || rightStart != condStart + 2 || pCode[condStart].op != lda || pCode[condStart + 1].op != ldv ||
+		incr < bodyStart || pCode[incr].op != lda || pCode[incr].arg != var || pCode[incr + 1].op != lda || pCode[incr + 1].arg != var ||
+		pCode[incr + 2].op != ldv || pCode[incr + 3].op != ldi || step <= 0 || pCode[incr + 4].op != add || pCode[incr + 5].op != sto)
+		shape = "not of the form WHILE i <= b DO ... i := i + c END";
+	else if (unrollFactor < 2)
+		reason = "unrolling is turned off";
+	else if ((bodyEnd - bodyStart) * unrollFactor > unrollMaxCode)
+		reason = "body too large";
+
+	for (int i = bodyStart; i < bodyEnd && shape == NULL; i++)
+	{
+		if (isCall(pCode[i].op))
+			shape = "a procedure called in the body may change the counter";
+		else if (isJump(pCode[i].op) && pCode[i].arg > incr)
+			shape = "counter is not always incremented";
+		else if (i < incr && pCode[i].op == lda && pCode[i + 1].op != ldv)
+		{
+			if (pCode[i].arg == var)
+				shape = "counter changed in the body";
+			for (int k = rightStart; k < guard; k++)
+				if (pCode[k].op == lda && pCode[k].arg == pCode[i].arg) shape = "bound changed in the body";
+		}
+	}
+	for (int k = rightStart; k < guard && shape == NULL; k++)
+		if (pCode[k].op != ldi && pCode[k].op != lda && pCode[k].op != ldv && !(pCode[k].op >= add && pCode[k].op <= dvd) &&
+			!(pCode[k].op >= shl && pCode[k].op <= dvi))
+			shape = "bound is not an expression";
+	counted = shape == NULL;
+	if (reason == NULL) reason = shape;
+
+	if (listJson)
+	{
+		listing << "{\"kind\":\"loop\",\"code\":" << condStart << ",\"unrolled\":" << (reason == NULL ? "true" : "false");
+		if (reason != NULL) { listing << ",\"reason\":"; jsonString(reason, strlen(reason)); }
+		else { listing << ",\"factor\":" << unrollFactor << ",\"counter\":"; jsonString(symTab[var].name.data(), symTab[var].name.size()); }
+		listing << "}\n";
+	}
+	else if (listMode == listNone) {}
+	else if (reason != NULL)
+		listing << setw(6) << "" << " WHILE at " << condStart << " not unrolled: " << reason << '\n';
+	else
+		listing << setw(6) << "" << " WHILE at " << condStart << " unrolled " << unrollFactor << " times, counter "
+			 << symTab[var].name << " step " << step << '\n';
+	return reason == NULL;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//	void proveIndexes(int condStart, int rightStart, int guard, int bodyStart, int incr,
+//					  opCodes relOp, int var)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::proveIndexes(int condStart, int rightStart, int guard, int bodyStart, int incr, opCodes relOp, int var)
+{
+	// In a counted loop entered only after i := a, with a literal bound b, the counter is
+	// from a to b (b - 1 for '<') all through the body. A CHK in the body of the index i,
+	// i + k or i - k then passes if it passes for both ends, and becomes an inb.
+	if (condStart < 3 || pCode[condStart - 3].op != lda || pCode[condStart - 3].arg != var ||
+		pCode[condStart - 2].op != ldi || pCode[condStart - 1].op != sto || guard != rightStart + 1 || pCode[rightStart].op != ldi)
+		return;
+	long long low = pCode[condStart - 2].arg, high = pCode[rightStart].arg - (relOp == lss ? 1 : 0);
+	int proven = 0, k;
+	for (int i = bodyStart; i < incr; i++)
+	{
+		if (pCode[i].op != chk) continue;
+		if (i - 2 >= bodyStart && pCode[i - 2].op == lda && pCode[i - 2].arg == var && pCode[i - 1].op == ldv)
+			k = 0;
+		else if (i - 4 >= bodyStart && pCode[i - 4].op == lda && pCode[i - 4].arg == var && pCode[i - 3].op == ldv &&
+			pCode[i - 2].op == ldi && (pCode[i - 1].op == add || pCode[i - 1].op == sub))
+			k = pCode[i - 1].op == add ? pCode[i - 2].arg : -pCode[i - 2].arg;
+		else
+			continue;
+		if (low + k >= 0 && high + k < pCode[i].arg)
+		{
+			pCode[i].op = inb;
+			proven++;
+		}
+	}
+
+	if (proven == 0 || listMode == listNone) return;
+	if (listJson)
+		listing << "{\"kind\":\"bounds\",\"code\":" << condStart << ",\"proven\":" << proven << "}\n";
+	else
+		listing << setw(6) << "" << " WHILE at " << condStart << " proves " << proven << " index checks\n";
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//	void unrollLoop(int rightStart, int guard, int bodyStart, int bodyEnd, opCodes relOp, int var, int step)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::unrollLoop(int rightStart, int guard, int bodyStart, int bodyEnd, opCodes relOp, int var, int step)
+{
+	// The body already emitted runs single iterations. After it, as long as i + (n-1)*c still
+	// satisfies the condition, n copies of the body run without a test between them:
+	//		test i, JMP-if-false exit ; body ; [i + (n-1)*c, JMP-if-false rest ; body * n ; i + (n-1)*c, JMP-if-true]
+	//		rest: test i, JMP-if-true body
+	int ahead = (unrollFactor - 1) * step, rest, mainStart;
+	rest = CGloopTest(var, ahead, rightStart, guard, branchOn(relOp, false), -1);
+	mainStart = nextCode;
+	for (int n = 0; n < unrollFactor; n++)
+		copyCode(bodyStart, bodyEnd);
+	CGloopTest(var, ahead, rightStart, guard, branchOn(relOp, true), mainStart);
+	backPatch(rest, nextCode);
+	CGloopTest(var, 0, rightStart, guard, branchOn(relOp, true), bodyStart);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//	int CGloopTest(int var, int offset, int boundFrom, int boundTo, opCodes branch, int target)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::CGloopTest(int var, int offset, int boundFrom, int boundTo, opCodes branch, int target)
+{
+	// compare var + offset with the bound computed by pCode[boundFrom..boundTo)
+	CGloadAddress(var);
+	CGdereference();
+	if (offset != 0)
+	{
+		CGloadConstant(offset);
+		gen(add, 0);
+	}
+	copyCode(boundFrom, boundTo);
+	gen(branch, target);
+	return nextCode - 1;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void copyCode(int from, int to)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::copyCode(int from, int to)
+{
+	// append a copy of pCode[from..to); jumps within the copied code are relocated
+	int offset = nextCode - from;
+	for (int i = from; i < to; i++)
+	{
+		gen(pCode[i].op, pCode[i].arg);
+		if (isJump(pCode[i].op) && pCode[i].arg >= from && pCode[i].arg <= to)
+			pCode[nextCode - 1].arg += offset;
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void moveCode(int from, int mid, int to)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::moveCode(int from, int mid, int to)
+{
+	// put pCode[mid..to) in front of pCode[from..mid) and relocate the jumps in them; a jump to
+	// mid, the end of the first part, goes to the end of both
+	int first = mid - from, second = to - mid;
+	rotate(pCode.begin() + from, pCode.begin() + mid, pCode.begin() + to);
+	for (int i = from; i < to; i++)
+		if (isJump(pCode[i].op) && !isCall(pCode[i].op))
+		{
+			int &arg = pCode[i].arg;
+			if (arg >= from && arg <= mid) arg += second;
+			else if (arg > mid && arg < to) arg -= first;
+		}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void caseStat(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::caseStat(void)
+{
+	// <caseStat> -> 'CASE' <i-expression> 'OF' <caseArm> { ';' <caseArm> } [ 'ELSE' <statSequence> ] 'END'
+	// <caseArm>  -> <number> { ',' <number> } ':' <statSequence>
+	// The selector is taken aside while the arms are compiled, each but the last ending in a
+	// jump to the end; the dispatch on it is compiled after them and moved in front. Listed.
+	caseRec c;
+	vector<int> exits;
+	int from = nextCode, mid;
+	getSym();
+	expression();
+	c.selector.assign(pCode.begin() + from, pCode.begin() + nextCode);
+	pCode.resize(from);
+	nextCode = from;
+	accept(ofSym, 35);
+	do
+	{
+		if (!c.labels.empty())
+		{
+			exits.push_back(nextCode);
+			CGJump(-1);
+		}
+		for (;;)
+		{
+			if (sym != numberSym) { error(37); break; }
+			for (size_t k = 0; k < c.labels.size(); k++)
+				if (c.labels[k].value == number) error(38);
+			c.labels.push_back({ number, nextCode });
+			getSym();
+			if (sym != commaSym) break;
+			getSym();
+		}
+		if (sym != colonSym) error(36);
+		caseArm = true;
+		statementSequence();
+	} while (sym == numberSym && !hasError);
+	c.otherwise = -1;
+	if (sym == elseSym)
+	{
+		exits.push_back(nextCode);
+		CGJump(-1);
+		c.otherwise = nextCode;
+		statementSequence();
+	}
+	if (!hasError)
+	{
+		mid = nextCode;
+		if (c.otherwise < 0) c.otherwise = mid;
+		for (size_t k = 0; k < exits.size(); k++) pCode[exits[k]].arg = mid;
+		caseDispatch(c);
+		moveCode(from, mid, nextCode);
+		joinAt = nextCode;
+
+		if (listJson)
+			listing << "{\"kind\":\"case\",\"code\":" << from << ",\"labels\":" << c.labels.size() << ",\"tables\":" << c.tables
+				<< ",\"compares\":" << c.compares << "}\n";
+		else if (listMode != listNone)
+			listing << setw(6) << "" << " CASE at " << from << " with " << c.labels.size() << " labels, jump tables " << c.tables
+				<< ", compares " << c.compares << '\n';
+	}
+	accept(endSym, 14);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void caseDispatch(caseRec &c)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::caseDispatch(caseRec &c)
+{
+	// The labels are split into clusters, each as long as it stays dense enough for a jump table;
+	// a cluster of caseTableMin labels or more gets one, a smaller one a compare per label, and a
+	// binary search over the clusters leads to them. A selector that is more than a constant or
+	// a variable and is needed more than once is kept in caseSlot when the code is optimized,
+	// and computed again when it is not, which it may be, as an expression changes nothing.
+	vector<pair<int, int> > clusters;
+	sort(c.labels.begin(), c.labels.end(), [](const caseLabelRec &x, const caseLabelRec &y) { return x.value < y.value; });
+	for (size_t i = 0, j; i < c.labels.size(); i = j)
+	{
+		for (j = i + 1; j < c.labels.size() && c.labels[j].value - c.labels[i].value < caseTableFill * (int)(j - i + 1); j++) {}
+		clusters.push_back(make_pair((int)i, (int)j));
+	}
+
+	int size = clusters[0].second - clusters[0].first;
+	bool simple = c.selector.size() == 1 || (c.selector.size() == 2 && (c.selector[0].op == lda || c.selector[0].op == lla) && c.selector[1].op == ldv);
+	bool once = clusters.size() == 1 && (size >= caseTableMin || size == 1);
+	c.slot = c.tables = c.compares = 0;
+	if (!simple && !once && incremental == nullptr && stream == nullptr)
+	{
+		if (caseSlot == 0) caseSlot = ++varAreaSize;
+		CGloadAddress(caseSlot);
+		CGcaseSelector(c);
+		CGassignment();
+		c.slot = caseSlot;
+	}
+	caseTree(c, clusters, 0, (int)clusters.size());
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//	void caseTree(caseRec &c, const vector<pair<int, int> > &clusters, int from, int to)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::caseTree(caseRec &c, const vector<pair<int, int> > &clusters, int from, int to)
+{
+	// the dispatch over clusters from..to-1; values below the first label of the middle one
+	// go to the left half
+	if (to - from > 1)
+	{
+		int half = (from + to) / 2, left;
+		CGcaseSelector(c);
+		CGloadConstant(c.labels[clusters[half].first].value);
+		left = nextCode;
+		gen(jlt, -1);
+		c.compares++;
+		caseTree(c, clusters, half, to);
+		backPatch(left, nextCode);
+		caseTree(c, clusters, from, half);
+		return;
+	}
+
+	int first = clusters[from].first, last = clusters[from].second - 1;
+	int low = c.labels[first].value, high = c.labels[last].value;
+	if (last - first + 1 >= caseTableMin)
+	{
+		// JTB n takes entry v of the n + 1 that follow it, or the last one if v is not below n;
+		// a table from 0, if that is still dense enough, saves subtracting the lowest label
+		int base = high < caseTableFill * (last - first + 1) ? 0 : low;
+		CGcaseSelector(c);
+		if (base != 0)
+		{
+			CGloadConstant(base);
+			gen(sub, 0);
+		}
+		gen(jtb, high - base + 1);
+		for (int v = base, k = first; v <= high; v++)
+			gen(jte, c.labels[k].value == v ? c.labels[k++].arm : c.otherwise);
+		gen(jte, c.otherwise);
+		c.tables++;
+	}
+	else
+	{
+		for (int k = first; k <= last; k++)
+		{
+			CGcaseSelector(c);
+			CGloadConstant(c.labels[k].value);
+			gen(jeq, c.labels[k].arm);
+			c.compares++;
+		}
+		CGJump(c.otherwise);
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void CGcaseSelector(caseRec &c)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::CGcaseSelector(caseRec &c)
+{
+	// the value of the selector, from the slot it is kept in or computed again
+	if (c.slot > 0)
+	{
+		CGloadAddress(c.slot);
+		CGdereference();
+	}
+	else
+		for (size_t k = 0; k < c.selector.size(); k++) gen(c.selector[k].op, c.selector[k].arg);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void backPatch(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::backPatch(int loc, int arg)
+{
+	if (loc < nextCode) pCode[loc].arg = arg;
+	joinAt = arg;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void statement(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::statement(void)
+{
+	// <statement> -> <i-assignStat> | <a-assignStat> | <writeStat> | <readStat> | <ifStat> | <whileStat> | <forStat> |
+	//				  <caseStat> | <fillStat> | <callStat>
+	int entry;
+	switch (sym)
+	{
+	case varIdentSym:
+		entry = symHash[findSymSlot()];
+		if (entry != 0 && symTab[entry].kind == procKind) callStat(entry);
+		else assignStat();
+		break;
+	case writeSym:    writeStat(); break;
+	case readSym:     readStat(); break;
+	case endlSym:     CGdoCRLF(); getSym();  break;
+	case ifSym:		  ifStat();  break;
+	case whileSym:    whileStat(); break;
+	case forSym:      forStat(); break;
+	case caseSym:     caseStat(); break;
+	case fillSym:     fillStat();
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void statementSequence(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::statementSequence(void)
+{
+	// <statSequence> -> <statement> { ';' <statement> }
+	// the code before a top-level statement is finished and can be streamed; top-level
+	// statements are recorded for an incremental compile. The sequence of a CASE arm ends
+	// where a label follows a ';'.
+	bool arm = caseArm, first = true;
+	caseArm = false;
+	nesting++;
+	do
+	{
+		if (nesting == 1 && stream != nullptr) publishCode();
+		if (nesting == 1 && incremental != nullptr)
+		{
+			if (!stats.empty() && spliceStatements()) break;
+			stats.push_back({ (int)(srcPos - source.data()), lineNo, (int)(lineStart - source.data()), nextCode });
+		}
+		getSym();
+		if ((sym == varIdentSym) || (sym == writeSym) || (sym == endlSym) || (sym == ifSym) || (sym == whileSym) || (sym == forSym) || (sym == caseSym) ||
+			(sym == fillSym) || (sym == readSym))
+			statement();
+		else if (arm && !first && sym == numberSym)
+			break;
+		else
+			error(13);
+		first = false;
+	} while (sym == semicolonSym);
+	nesting--;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void mainProgSection(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::mainProgSection(void)
+{
+	// <mainProgSection> -> 'BEGIN' <statSequence> 'END'
+	if (sym != beginSym)
+		error(10);
+	statementSequence();
+	accept(endSym, 14);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void varDeclaration(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::varDeclaration(void)
+{
+	// <varDeclaration> -> 'DECLARE' <varIdent> { ',' <varIdent> } ';'
+	getSym();
+	if (sym != declareSym)
+		error(9);
+	do
+	{
+		getSym();
+		if (sym != varIdentSym)
+			error(7);
+		else
+		{
+			enter();
+			getSym();
+			if (sym == leftBracketSym)
+			{
+				// <varDecl> -> <varIdent> '[' <number> ']'
+				getSym();
+				if (sym != numberSym || number < 1) error(25);
+				else if (!hasError) symTab[lastEntry].size = number;
+				getSym();
+				accept(rightBracketSym, 24);
+			}
+		}
+	} while (sym == commaSym);
+	accept(semicolonSym, 12);
+	placeArrays();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void placeArrays(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::placeArrays(void)
+{
+	// the arrays follow the scalars, in the order declared; an array keeps the scalar slot of its
+	// entry unused, which optimize() gives up
+	for (int i = 1; i <= lastEntry; i++)
+		if (symTab[i].size > 0)
+		{
+			symTab[i].address = lastEntry + 1 + arrayAreaSize;
+			arrayAreaSize += symTab[i].size;
+		}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void procDeclaration(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::procDeclaration(void)
+{
+	// <procDeclaration> -> 'PROCEDURE' <varIdent> [ '(' <varIdent> { ',' <varIdent> } ')' ] ';'
+	//                      [ 'DECLARE' <varIdent> { ',' <varIdent> } ';' ] 'BEGIN' <statSequence> 'END' ';'
+	// The frame of a call holds the arguments, pushed by the caller, the return address and the
+	// caller's frame pointer, pushed by CAL, and the variables, reserved by ENT. The frame pointer
+	// points at the saved one, so parameter k of n is at LLA k-n-1 and variable k at LLA k.
+	int proc = (int)procs.size(), params, locals = 0;
+	getSym();
+	if (sym != varIdentSym) error(7);
+	else enterLocal(procKind, proc);
+	procs.push_back({ nextCode, 0, 0, 0, -1, 0, false });
+	scopeFrom = (int)symTab.size();
+	getSym();
+	if (sym == leftParenSym)
+	{
+		do
+		{
+			getSym();
+			if (sym != varIdentSym) error(7);
+			else enterLocal(localKind, 0);
+			getSym();
+			if (sym == leftBracketSym) error(34);
+		} while (sym == commaSym);
+		accept(rightParenSym, 2);
+	}
+	params = (int)symTab.size() - scopeFrom;
+	for (int k = 0; k < params; k++)
+		symTab[scopeFrom + k].address = k - params - 1;
+	accept(semicolonSym, 12);
+	if (sym == declareSym)
+	{
+		do
+		{
+			getSym();
+			if (sym != varIdentSym) error(7);
+			else enterLocal(localKind, ++locals);
+			getSym();
+			if (sym == leftBracketSym) error(34);
+		} while (sym == commaSym);
+		accept(semicolonSym, 12);
+	}
+	if (sym != beginSym) error(10);
+
+	procs[proc].params = params;
+	procs[proc].locals = locals;
+	CGenter(locals);
+	procs[proc].bodyFrom = nextCode;
+	nesting++;		// its statements are not top-level ones
+	statementSequence();
+	nesting--;
+	pCode[procs[proc].bodyFrom - 1].arg = procs[proc].locals;	// with the limits of its FORs
+	accept(endSym, 14);
+	procs[proc].bodyTo = nextCode;
+	tailCalls(procs[proc], symTab[scopeFrom - 1].name);
+	CGreturn(params);
+	accept(semicolonSym, 12);
+	leaveScope();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void callStat(int procEntry)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::callStat(int procEntry)
+{
+	// <callStat> -> <varIdent> [ '(' <i-expression> { ',' <i-expression> } ')' ]
+	// the arguments are pushed for a CAL, or stored in the parameters of an inlined copy, which
+	// reads a constant or a variable the copy does not change in place of its parameter
+	procRec &proc = procs[symTab[procEntry].address];
+	bool inlined = inlineCall(procEntry);
+	vector<vector<pInstruction> > inPlace(inlined ? proc.params : 0);
+	int args = 0;
+	getSym();
+	if (sym == leftParenSym)
+	{
+		do
+		{
+			getSym();
+			int from = nextCode;
+			if (inlined && args < proc.params) CGloadAddress(proc.slots + args);
+			expression();
+			if (inlined && args < proc.params)
+			{
+				if (argumentInPlace(proc, args, from + 1))
+				{
+					inPlace[args].assign(pCode.begin() + from + 1, pCode.end());
+					pCode.resize(from);
+					nextCode = from;
+				}
+				else CGassignment();
+			}
+			args++;
+		} while (sym == commaSym);
+		accept(rightParenSym, 2);
+	}
+	if (args != proc.params) error(33);
+	if (inlined) inlineCode(proc, inPlace);
+	else CGcall(proc.entry);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						bool inlineCall(int procEntry)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool compiler::inlineCall(int procEntry)
+{
+	// A call is inlined when the code is optimized, unless the procedure calls itself or its
+	// body is larger than inlineMaxCode; the copies share slots, taken at the first one, as
+	// a procedure that does not call itself cannot be in two of them at once. Listed.
+	procRec &proc = procs[symTab[procEntry].address];
+	const char *reason = NULL;
+	if (incremental != nullptr || stream != nullptr) return false;
+	if (proc.bodyTo < 0) proc.recursive = true;
+	if (proc.recursive)
+		reason = "it calls itself";
+	else if (proc.bodyTo - proc.bodyFrom > inlineMaxCode)
+		reason = "body too large";
+	else if (proc.slots == 0)
+	{
+		proc.slots = varAreaSize + 1;
+		varAreaSize += proc.params + proc.locals;
+	}
+
+	const string &name = symTab[procEntry].name;
+	if (listJson)
+	{
+		listing << "{\"kind\":\"call\",\"code\":" << nextCode << ",\"procedure\":";
+		jsonString(name.data(), name.size());
+		listing << ",\"inlined\":" << (reason == NULL ? "true" : "false");
+		if (reason != NULL) { listing << ",\"reason\":"; jsonString(reason, strlen(reason)); }
+		listing << "}\n";
+	}
+	else if (listMode == listNone) {}
+	else if (reason != NULL)
+		listing << setw(6) << "" << " CALL of " << name << " at " << nextCode << " not inlined: " << reason << '\n';
+	else
+		listing << setw(6) << "" << " CALL of " << name << " at " << nextCode << " inlined\n";
+	return reason == NULL;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void inlineCode(procRec &proc)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::inlineCode(procRec &proc, const vector<vector<pInstruction> > &inPlace)
+{
+	// a copy of the body with LLA d turned into an LDA of the slot of d, LLA d LDV into the
+	// argument read in place of d, and jumps within the body moved with it; the variables
+	// start at 0 as those of a frame do
+	for (int k = 0; k < proc.locals; k++)
+	{
+		CGloadAddress(proc.slots + proc.params + k);
+		CGloadConstant(0);
+		CGassignment();
+	}
+	vector<int> moved(proc.bodyTo - proc.bodyFrom + 1);
+	for (int i = proc.bodyFrom, at = nextCode; i <= proc.bodyTo; i++)
+	{
+		moved[i - proc.bodyFrom] = at++;
+		if (i < proc.bodyTo && pCode[i].op == lla && pCode[i].arg < 0 && !inPlace[pCode[i].arg + proc.params + 1].empty())
+		{
+			at += (int)inPlace[pCode[i].arg + proc.params + 1].size() - 2;
+			moved[++i - proc.bodyFrom] = at++;
+		}
+	}
+	for (int i = proc.bodyFrom; i < proc.bodyTo; i++)
+	{
+		pInstruction in = pCode[i];
+		if (in.op == lla && in.arg < 0 && !inPlace[in.arg + proc.params + 1].empty())
+		{
+			for (const pInstruction &arg : inPlace[in.arg + proc.params + 1])
+				gen(arg.op, arg.arg);
+			i++;
+		}
+		else if (in.op == lla)
+			CGloadAddress(proc.slots + (in.arg < 0 ? in.arg + proc.params + 1 : proc.params + in.arg - 1));
+		else if (isJump(in.op) && !isCall(in.op) && in.arg >= proc.bodyFrom && in.arg <= proc.bodyTo)
+			gen(in.op, moved[in.arg - proc.bodyFrom]);
+		else
+			gen(in.op, in.arg);
+	}
+	joinAt = nextCode;	// the body may jump to its end
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				void tailCalls(procRec &proc, const string &name)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::tailCalls(procRec &proc, const string &name)
+{
+	// a CAL of the procedure by itself from which nothing but jumps lead to its RET, at bodyTo,
+	// becomes a TCL; listed
+	for (int i = proc.bodyFrom; i < proc.bodyTo; i++)
+	{
+		if (pCode[i].op != cal || pCode[i].arg != proc.entry) continue;
+		int next = i + 1;
+		for (int hops = 0; next >= proc.bodyFrom && next < proc.bodyTo && pCode[next].op == jmp && hops < proc.bodyTo - proc.bodyFrom; hops++)
+			next = pCode[next].arg;
+		if (next != proc.bodyTo) continue;
+		pCode[i].op = tcl;
+
+		if (listJson)
+		{
+			listing << "{\"kind\":\"call\",\"code\":" << i << ",\"procedure\":";
+			jsonString(name.data(), name.size());
+			listing << ",\"tail\":true}\n";
+		}
+		else if (listMode != listNone)
+			listing << setw(6) << "" << " CALL of " << name << " at " << i << " is a tail call\n";
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		bool argumentInPlace(const procRec &proc, int param, int from)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool compiler::argumentInPlace(const procRec &proc, int param, int from)
+{
+	// the argument from .. nextCode-1 is a constant or a scalar, the body only reads the
+	// parameter, and it changes no global scalar read this way; a CAL in the body might
+	int length = nextCode - from, d = param - proc.params - 1;
+	bool constant = length == 1 && pCode[from].op == ldi;
+	bool variable = length == 2 && (pCode[from].op == lda || pCode[from].op == lla) && pCode[from + 1].op == ldv;
+	if (!constant && !variable) return false;
+	for (int i = proc.bodyFrom; i < proc.bodyTo; i++)
+	{
+		const pInstruction &in = pCode[i];
+		bool written = pCode[i + 1].op != ldv;
+		if (in.op == lla && in.arg == d && written) return false;
+		if (variable && pCode[from].op == lda && (isCall(in.op) || (in.op == lda && in.arg == pCode[from].arg && written)))
+			return false;
+	}
+	return true;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void indexExpression(int arrayEntry)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::indexExpression(int arrayEntry)
+{
+	// '[' <i-expression> ']' after the name of an array, checked against its size
+	if (sym != leftBracketSym) error(26);
+	getSym();
+	int indexStart = nextCode;
+	expression();
+	accept(rightBracketSym, 24);
+	CGcheckIndex(indexStart, symTab[arrayEntry].size);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				void CGcheckIndex(int indexStart, int size)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::CGcheckIndex(int indexStart, int size)
+{
+	// an index computed by pCode[indexStart..nextCode) is checked, unless it is a constant in range
+	if (nextCode == indexStart + 1 && pCode[indexStart].op == ldi && pCode[indexStart].arg >= 0 && pCode[indexStart].arg < size)
+		return;
+	gen(chk, size);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					int addressOf(const string &name)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::addressOf(const string &name)
+{
+	// 0 for a name not declared, an array, or a variable optimize() found unused; the name is
+	// in upper case, as identifiers are kept
+	for (int i = 1; i <= lastEntry; i++)
+		if (symTab[i].name == name) return symTab[i].size > 0 ? 0 : symTab[i].address;
+	return 0;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void printSymTab(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::printSymTab(void)
+{
+	int i;
+	if (listMode == listNone) return;
+	if (listJson)
+	{
+		for (i = 1; i <= lastEntry; i++)
+		{
+			listing << "{\"kind\":\"symbol\",\"no\":" << i << ",\"name\":";
+			jsonString(symTab[i].name.data(), symTab[i].name.size());
+			listing << ",\"address\":" << symTab[i].address << ",\"unused\":" << (symTab[i].address == 0 ? "true" : "false");
+			if (symTab[i].size > 0) listing << ",\"size\":" << symTab[i].size;
+			listing << "}\n";
+		}
+		return;
+	}
+	listing << "\nSymbol Table:\n";
+	listing << " No.   VarName     VarAddress\n";
+	for (i = 1; i <= lastEntry; i++)
+	{
+		listing << "  " << i << "     " << left << setw(wLeng) << symTab[i].name << right;
+		if (symTab[i].address == 0)
+			listing << "       (unused)\n";
+		else if (symTab[i].size > 0)
+			listing << "       " << symTab[i].address << " [" << symTab[i].size << "]\n";
+		else
+			listing << "       " << symTab[i].address << '\n';
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						int expression(int opened)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::expression(int opened)
+{
+	// <i-expression> -> <term> { ('+' | '-') <term> }
+	// <term>         -> <factor> { ('*' | '/') <factor> }
+	// <factor>       -> <number> | <variable> | <reduction> | 'EOF' | '(' <i-expression> ')'
+	// <reduction>    -> ('SUM' | 'MIN' | 'MAX') '(' <varIdent> ')'
+	// parsed without recursion, so parentheses may nest as deep as memory allows; exprStack keeps
+	// a leftParenSym for each open parenthesis, a leftBracketSym for each open index, and each
+	// operator waiting for its right operand. A condition passes in the parentheses it has read
+	// before the expression; those still open when a relation follows group the condition, and
+	// their number is returned
+	int varIdLoc = 0;
+	exprStack.assign(opened, leftParenSym);
+	indexed.clear();
+	for (;;)
+	{
+		// <factor>, a '(' or an index starts an <i-expression> inside it
+		while (sym == leftParenSym)
+		{
+			exprStack.push_back(leftParenSym);
+			getSym();
+		}
+		switch (sym)
+		{
+		case varIdentSym:
+			searchIdLoc(varIdLoc);
+			if (symTab[varIdLoc].size > 0)
+			{
+				getSym();
+				if (sym != leftBracketSym) error(26);
+				exprStack.push_back(leftBracketSym);
+				indexed.push_back(varIdLoc);
+				indexed.push_back(nextCode);
+				getSym();
+				continue;
+			}
+			CGloadVariable(varIdLoc);
+			CGdereference();
+			getSym();
+			if (sym == leftBracketSym) error(27);
+			break;
+		case numberSym:
+			CGloadConstant(number);	getSym();	break;
+		case eofSym:
+			CGendOfInput(); getSym(); break;
+		case sumSym: case minSym: case maxSym:
+		{
+			opCodes op = sym == sumSym ? vsm : sym == minSym ? vmn : vmx;
+			getSym();
+			accept(leftParenSym, 30);
+			CGbulkOp(op, arrayOperand(0));
+			accept(rightParenSym, 2);
+			break;
+		}
+		default: error(6);
+		}
+
+		// apply the operators the factor completes, until one needs another factor
+		for (;;)
+		{
+			if (!exprStack.empty() && (exprStack.back() == timesSym || exprStack.back() == slashSym))
+			{
+				CGbinaryIntOp(exprStack.back());
+				exprStack.pop_back();
+			}
+			if (sym == timesSym || sym == slashSym)
+			{
+				symbols mulOp = sym;
+				getSym();
+				if (sym == numberSym)
+				{
+					CGconstIntOp(mulOp, number);
+					getSym();
+					continue;
+				}
+				exprStack.push_back(mulOp);
+				break;
+			}
+
+			// the <term> is complete
+			if (!exprStack.empty() && (exprStack.back() == plusSym || exprStack.back() == minusSym))
+			{
+				CGbinaryIntOp(exprStack.back());
+				exprStack.pop_back();
+			}
+			if (sym == plusSym || sym == minusSym)
+			{
+				exprStack.push_back(sym);
+				getSym();
+				break;
+			}
+
+			// the <i-expression> is complete, and unless it is the outermost one it ends a <factor>
+			if (exprStack.empty()) return 0;
+			if (opened > 0 && sym >= eqlSym && sym <= leqSym && count(exprStack.begin(), exprStack.end(), leftParenSym) == (int)exprStack.size())
+				return (int)exprStack.size();
+			if (exprStack.back() == leftBracketSym)
+			{
+				int indexStart = indexed.back(); indexed.pop_back();
+				int arrayEntry = indexed.back(); indexed.pop_back();
+				accept(rightBracketSym, 24);
+				CGcheckIndex(indexStart, symTab[arrayEntry].size);
+				CGloadElement(symTab[arrayEntry].address);
+			}
+			else
+				accept(rightParenSym, 2);
+			exprStack.pop_back();
+		}
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void gen(opCodes op, int arg)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::gen(opCodes op, int arg)
+{
+	if (nextCode == codeLimit)
+	{
+		error(21);
+		return;
+	}
+	pCode.push_back({ op, arg });
+	nextCode++;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void dumpCode(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::dumpCode(void)
+{
+	// the columns are laid out by hand, setw() on a stream costs more than an incremental compile
+	string text((size_t)nextCode * 34, ' ');
+	char *end = &text[0];
+	for (int i = 0; i < nextCode; i++)
+	{
+		end = putField(end, 10, i);
+		end = putField(end, 5, mnemonic[pCode[i].op], 3);
+		if (hasArg(pCode[i].op))
+			end = putField(end, 5, pCode[i].arg);
+		*end++ = '\n';
+	}
+	text.resize(end - text.data());
+	codeFile.write(text.data(), text.size());
+	if (useCache && !hasError)
+	{
+		// the entry keeps the global symbols ahead of the code, for the listing and addressOf() of a hit
+		ostringstream entry;
+		entry << lastEntry << '\n';
+		for (int i = 1; i <= lastEntry; i++)
+			entry << symTab[i].name << ' ' << symTab[i].address << ' ' << symTab[i].size << '\n';
+		cache.store(cacheKey, entry.str() + text);
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//			char *putField(char *p, int width, const char *s, size_t len)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline char *compiler::putField(char *p, int width, const char *s, size_t len)
+{
+	// s right-aligned in width columns, as setw() does; returns the end
+	for (int pad = width - (int)len; pad > 0; pad--) *p++ = ' ';
+	memcpy(p, s, len);
+	return p + len;
+}
+
+inline char *compiler::putField(char *p, int width, int n)
+{
+	char digits[16];
+	char *end = to_chars(digits, digits + sizeof digits, n).ptr;
+	return putField(p, width, digits, end - digits);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void publishCode(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::publishCode(void)
+{
+	// put the code generated since the last call in the stream; nothing after an error
+	if (hasError) return;
+	for (; published < nextCode; published++)
+		stream->put(mnemonic[pCode[published].op], hasArg(pCode[published].op) ? pCode[published].arg : 0);
+	stream->publish();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							bool fetchCached(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool compiler::fetchCached(void)
+{
+	// the key covers the source, the compiler version and every limit that changes the code
+	if (!useCache) return false;
+	ostringstream key;
+	key << compilerVersion << '\n' << MaxInt << ' ' << codeLimit << ' ' << unrollFactor << ' ' << unrollMaxCode << ' '
+		<< inlineMaxCode << ' ' << caseTableMin << ' ' << caseTableFill << '\n' << compileCache::sha256(source);
+	cacheKey = compileCache::sha256(key.str());
+
+	// an entry is the count of the global symbols, a line for each, and the object code
+	string entry;
+	vector<symTabRec> symbols(1, symTabRec());
+	size_t codeAt = 0;
+	bool hit = cache.fetch(cacheKey, entry);
+	if (hit)
+	{
+		istringstream in(entry);
+		int count = -1;
+		in >> count;
+		for (int i = 1; i <= count && in; i++)
+		{
+			symTabRec rec = { "", 0, 0, 0, globalKind };
+			in >> rec.name >> rec.address >> rec.size;
+			symbols.push_back(rec);
+		}
+		hit = in && count >= 0 && in.get() == '\n';
+		codeAt = hit ? (size_t)in.tellg() : 0;
+	}
+	if (listJson)
+		listing << "{\"kind\":\"cache\",\"hit\":" << (hit ? "true" : "false") << ",\"key\":\"" << cacheKey << "\"}\n";
+	if (!hit) return false;
+
+	symTab.swap(symbols);
+	lastEntry = (int)symTab.size() - 1;
+	if (listText()) listing << "\n  Object code taken from the compile cache, entry " << cacheKey << "\n";
+	printSymTab();
+	codeFile.write(entry.data() + codeAt, entry.size() - codeAt);
+	return true;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void CGBinaryIntOp(symbols op)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::CGbinaryIntOp(symbols op)
+{
+	switch (op)
 	{
 	case plusSym:   gen(add, 0); break;
 	case timesSym:  gen(mul, 0); break;
@@ -982,6 +3068,887 @@ void compiler::CGbinaryIntOp(symbols op)
 	}
 }
 
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void CGconstIntOp(symbols op, int num)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::CGconstIntOp(symbols op, int num)
+{
+	// multiply or divide TopOfStack by the literal num
+	codeList code;
+	constIntOp(op == timesSym ? mul : dvd, num, code);
+	for (size_t i = 0; i < code.size(); i++)
+		gen(code[i].op, code[i].arg);
+}
+
+/* --------------------------------  Optimizer  --------------------------------------------- */
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void optimize(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::optimize(void)
+{
+	// improve pCode in place; the passes work on the labelled form of the code
+	codeList code;
+	toLabelled(code);
+	valueNumbering(code);
+	foldBranches(code);
+	removeUnreachable(code);
+	reduceStrength(code);
+	while (reduceInduction(code)) { /* one loop variable at a time */ }
+	while (removeDeadStores(code)) { /* until no store is removed */ }
+	compactVariables(code);
+	fromLabelled(code);
+	pCode[varAreaLoc].arg = varAreaSize + arrayAreaSize;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void toLabelled(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::toLabelled(codeList &code)
+{
+	// the label of a jump target is its address in pCode, new labels are numbered after those;
+	// index checks proven to pass are left out
+	vector<bool> target(nextCode + 1, false);
+	labelCount = nextCode + 1;
+	for (int i = 0; i < nextCode; i++)
+		if (isJump(pCode[i].op)) target[pCode[i].arg] = true;
+
+	code.clear();
+	for (int i = 0; i < nextCode; i++)
+	{
+		if (target[i]) code.push_back({ lbl, i });
+		if (pCode[i].op != inb) code.push_back(pCode[i]);
+	}
+	if (target[nextCode]) code.push_back({ lbl, nextCode });
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void fromLabelled(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::fromLabelled(codeList &code)
+{
+	unordered_map<int, int> labelLoc;
+	int loc = 0;
+	for (size_t i = 0; i < code.size(); i++)
+		if (code[i].op == lbl) labelLoc[code[i].arg] = loc;
+		else loc++;
+
+	nextCode = 0;
+	pCode.clear();
+	for (size_t i = 0; i < code.size(); i++)
+		if (code[i].op != lbl)
+		{
+			gen(code[i].op, code[i].arg);
+			if (isJump(code[i].op)) backPatch(nextCode - 1, labelLoc[code[i].arg]);
+		}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				void applyEdits(codeList &code, codeEdits &edits)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::applyEdits(codeList &code, codeEdits &edits)
+{
+	codeList result;
+	result.reserve(code.size());
+	for (size_t i = 0; i < code.size(); i++)
+	{
+		result.insert(result.end(), edits.before[i].begin(), edits.before[i].end());
+		if (!edits.deleted[i]) result.push_back(code[i]);
+		result.insert(result.end(), edits.after[i].begin(), edits.after[i].end());
+	}
+	code.swap(result);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//			void buildBlocks(codeList &code, vector<basicBlock> &blocks)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::buildBlocks(codeList &code, vector<basicBlock> &blocks)
+{
+	// a basic block starts at a label or after a jump, and is left only at its end; the entries
+	// of a jump table are blocks of their own, each going on to the next as well as to its target,
+	// and so are the operands after a LOP, which are not run
+	unordered_map<int, int> labelBlock;
+	blocks.clear();
+	for (int i = 0; i < (int)code.size(); i++)
+	{
+		if (blocks.empty() || code[i].op == lbl || endsBlock(code[i - 1].op) || (i >= 4 && code[i - 4].op == lop))
+			blocks.push_back({ i, i, vector<int>() });
+		if (code[i].op == lbl) labelBlock[code[i].arg] = (int)blocks.size() - 1;
+		blocks.back().to = i + 1;
+	}
+	for (size_t b = 0; b < blocks.size(); b++)
+	{
+		opCodes last = code[blocks[b].to - 1].op;
+		if (last != jmp && last != hlt && last != ret && last != tcl && b + 1 < blocks.size() && (last != jte || code[blocks[b].to].op == jte))
+			blocks[b].succ.push_back((int)b + 1);
+		if (isJump(last)) blocks[b].succ.push_back(labelBlock[code[blocks[b].to - 1].arg]);
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		void stackEffect(codeList &code, int i, int &pops, int &pushes)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::stackEffect(codeList &code, int i, int &pops, int &pushes)
+{
+	pops = pushes = 0;
+	switch (code[i].op)
+	{
+	case ldi: case lda: case ldb: case rdi: case eoi: case lla: pushes = 1; break;
+	case ldv: case shl: case sar: case mli: case dvi: case ldx: case chk: case inb: case vsm: case vmn: case vmx: pops = pushes = 1; break;
+	case add: case sub: case mul: case dvd: case eql: case neq: case lss: case leq: case gtr: case geq:
+		pops = 2; pushes = 1; break;
+	case sto: case stx: case vfl: case vcp: pops = 2; break;
+	case vad: case vsb: case vml: pops = 3; break;
+	case prn: case prc: case jmz: case jtb: pops = 1; break;
+	case jeq: case jne: case jlt: case jle: case jgt: case jge: pops = 2; break;
+	case prs: pops = (i > 0 && code[i - 1].op == ldi) ? code[i - 1].arg + 1 : 1; break;
+	default: break;
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//	void operandStarts(codeList &code, vector<basicBlock> &blocks, vector<int> &top, vector<int> &below)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::operandStarts(codeList &code, vector<basicBlock> &blocks, vector<int> &top, vector<int> &below)
+{
+	// where the code computing the topmost and the next operand of each instruction starts,
+	// -1 if the operand was pushed before the basic block
+	int pops, pushes;
+	top.assign(code.size(), -1);
+	below.assign(code.size(), -1);
+	for (size_t b = 0; b < blocks.size(); b++)
+	{
+		vector<int> starts;
+		for (int i = blocks[b].from; i < blocks[b].to; i++)
+		{
+			int start = i;
+			stackEffect(code, i, pops, pushes);
+			for (int k = 0; k < pops; k++)
+			{
+				start = starts.empty() ? -1 : starts.back();
+				if (!starts.empty()) starts.pop_back();
+				if (k == 0) top[i] = start;
+				if (k == 1) below[i] = start;
+			}
+			if (pushes > 0) starts.push_back(start);
+		}
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void valueNumbering(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::valueNumbering(codeList &code)
+{
+	// local value numbering: within a basic block a value that is already known is
+	// not recomputed, it is loaded as a constant, from a variable that still holds it,
+	// or from a temporary the first computation was spilled to
+	codeEdits edits(code.size());
+	vector<basicBlock> blocks;
+	int temps = 0;
+	buildBlocks(code, blocks);
+	for (size_t b = 0; b < blocks.size(); b++)
+		temps = max(temps, numberBlock(code, blocks[b].from, blocks[b].to, edits));
+	varAreaSize += temps; // temporaries of different blocks share slots
+	applyEdits(code, edits);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		int numberBlock(codeList &code, int from, int to, codeEdits &edits)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::numberBlock(codeList &code, int from, int to, codeEdits &edits)
+{
+	valueTable vt;
+	vt.temps = 0;
+	stackEntry l, r;
+	int vn, pops, pushes;
+
+	for (int i = from; i < to; i++)
+	{
+		// an entry popped from below the block's own pushes is an unknown value
+		r = { -1, -1 };
+		stackEffect(code, i, pops, pushes);
+		if (pops > 0)
+		{
+			if (vt.stack.empty()) vt.stack.push_back({ freshValue(vt), -1 });
+			r = vt.stack.back();
+			vt.stack.pop_back();
+		}
+
+		switch (code[i].op)
+		{
+		case lbl: case nln: case jmp: case hlt: case inc: case prn: case prc: case jmz: case ent: case ret: case jtb: case jte:
+			break;
+		case jeq: case jne: case jlt: case jle: case jgt: case jge: case stx: case vfl: case vcp:
+			if (!vt.stack.empty()) vt.stack.pop_back();
+			break;
+		case vad: case vsb: case vml:
+			for (int k = 0; k < 2 && !vt.stack.empty(); k++) vt.stack.pop_back();
+			break;
+		case chk: case inb:
+			vt.stack.push_back(r);	// the index, unchanged
+			break;
+		case ldx: case vsm: case vmn: case vmx:
+			// an element is not numbered, an STX may change it, nor is a reduction of an array
+			vt.stack.push_back({ freshValue(vt), r.start });
+			break;
+		case rdi: case eoi:
+			// nor is the input, which moves on
+			vt.stack.push_back({ freshValue(vt), i });
+			break;
+		case ldi: case lda: case ldb: case lla:
+			vt.stack.push_back({ valueOf(vt, code[i].op, code[i].arg, 0), i });
+			break;
+		case ldv:
+			if (vt.values[r.vn].op == lda)
+			{
+				int addr = vt.values[r.vn].a;
+				if (vt.varValue.count(addr) == 0) vt.varValue[addr] = freshValue(vt);
+				vn = vt.varValue[addr];
+				if (vt.inVar[vn] == 0) vt.inVar[vn] = addr;
+			}
+			else
+				vn = freshValue(vt);
+			vt.stack.push_back({ vn, r.start });
+			reuseValue(vt, edits, vn, r.start, i);
+			break;
+		case sto:
+			if (vt.stack.empty()) vt.stack.push_back({ freshValue(vt), -1 });
+			l = vt.stack.back();
+			vt.stack.pop_back();
+			if (vt.values[l.vn].op == lda)
+			{
+				vt.varValue[vt.values[l.vn].a] = r.vn;
+				vt.inVar[r.vn] = vt.values[l.vn].a;
+			}
+			else if (vt.values[l.vn].op != lla)	// a variable in a frame is no global
+				vt.varValue.clear();
+			break;
+		case prs:
+			if (vt.values[r.vn].op == ldi)
+				for (int k = 0; k < vt.values[r.vn].a && !vt.stack.empty(); k++) vt.stack.pop_back();
+			else
+				vt.stack.clear();
+			break;
+		case add: case sub: case mul: case dvd: case eql: case neq: case lss: case leq: case gtr: case geq:
+			if (vt.stack.empty()) vt.stack.push_back({ freshValue(vt), -1 });
+			l = vt.stack.back();
+			vt.stack.pop_back();
+			vn = combineValues(vt, code[i].op, l.vn, r.vn);
+			vt.stack.push_back({ vn, (l.start < 0 || r.start < 0) ? -1 : l.start });
+			reuseValue(vt, edits, vn, vt.stack.back().start, i);
+			break;
+		case shl: case sar: case mli: case dvi:
+			// numbered as the MUL or DVD by a constant they stand for
+			vn = valueOf(vt, ldi, (code[i].op == shl || code[i].op == sar) ? 1 << code[i].arg : code[i].arg, 0);
+			vn = combineValues(vt, (code[i].op == shl || code[i].op == mli) ? mul : dvd, r.vn, vn);
+			vt.stack.push_back({ vn, r.start });
+			reuseValue(vt, edits, vn, r.start, i);
+			break;
+		default:
+			vt.stack.clear();
+			vt.varValue.clear();
+		}
+	}
+	return vt.temps;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//			int valueOf(valueTable &vt, opCodes op, int a, int b)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::valueOf(valueTable &vt, opCodes op, int a, int b)
+{
+	long long key = ((long long)op << 56) ^ ((long long)(unsigned)a << 28) ^ (unsigned)b;
+	unordered_map<long long, int>::iterator it = vt.lookup.find(key);
+	if (it != vt.lookup.end()) { valueRec &v = vt.values[it->second]; if (v.op == op && v.a == a && v.b == b) return it->second; }
+
+	int vn = freshValue(vt);
+	vt.values[vn] = { op, a, b };
+	if (it == vt.lookup.end()) vt.lookup[key] = vn;
+	return vn;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					int freshValue(valueTable &vt)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::freshValue(valueTable &vt)
+{
+	// a value number equal to no other, e.g. the unknown content of a variable
+	int vn = (int)vt.values.size();
+	vt.values.push_back({ nul, vn, 0 });
+	vt.inVar.push_back(0);
+	vt.inTemp.push_back(0);
+	vt.firstStart.push_back(-1);
+	vt.firstEnd.push_back(-1);
+	return vn;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		int combineValues(valueTable &vt, opCodes op, int a, int b)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::combineValues(valueTable &vt, opCodes op, int a, int b)
+{
+	// fold constants, otherwise number the operation in a canonical operand order
+	if (vt.values[a].op == ldi && vt.values[b].op == ldi)
+	{
+		int x = vt.values[a].a, y = vt.values[b].a;
+		switch (op)
+		{
+		case add: return valueOf(vt, ldi, (int)((unsigned)x + (unsigned)y), 0);
+		case sub: return valueOf(vt, ldi, (int)((unsigned)x - (unsigned)y), 0);
+		case mul: return valueOf(vt, ldi, (int)((unsigned)x * (unsigned)y), 0);
+		case dvd: if (y != 0 && !(y == -1 && x == INT_MIN)) return valueOf(vt, ldi, x / y, 0); break;
+		case eql: return valueOf(vt, ldi, x == y, 0);
+		case neq: return valueOf(vt, ldi, x != y, 0);
+		case lss: return valueOf(vt, ldi, x < y, 0);
+		case leq: return valueOf(vt, ldi, x <= y, 0);
+		case gtr: return valueOf(vt, ldi, x > y, 0);
+		case geq: return valueOf(vt, ldi, x >= y, 0);
+		default: break;
+		}
+	}
+	if (op == gtr) { op = lss; swap(a, b); }
+	if (op == geq) { op = leq; swap(a, b); }
+	if ((op == add || op == mul || op == eql || op == neq) && a > b) swap(a, b);
+	return valueOf(vt, op, a, b);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//	void reuseValue(valueTable &vt, codeEdits &edits, int vn, int start, int end)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::reuseValue(valueTable &vt, codeEdits &edits, int vn, int start, int end)
+{
+	// code[start..end] computes value vn; replace it if vn is available more cheaply
+	if (start < 0) return;
+	int cost = editedLength(edits, start, end, 7), addr = 0;	// only compared with 1, 2 and 6
+	codeList with;
+
+	if (vt.values[vn].op == ldi)
+	{
+		if (cost > 1) with.push_back({ ldi, vt.values[vn].a });
+	}
+	else if (cost > 2)
+	{
+		unordered_map<int, int>::iterator held = vt.varValue.find(vt.inVar[vn]);
+		if (held != vt.varValue.end() && held->second == vn)
+			addr = vt.inVar[vn];
+		else if (vt.inTemp[vn] != 0)
+			addr = vt.inTemp[vn];
+		else if (vt.firstStart[vn] >= 0 && cost > 6)
+		{
+			// spill the first computation: LDA t before it, STO LDA t LDV after it
+			addr = varAreaSize + (++vt.temps);
+			codeList &pre = edits.before[vt.firstStart[vn]], &post = edits.after[vt.firstEnd[vn]];
+			pre.insert(pre.begin(), { lda, addr });
+			post.push_back({ sto, 0 });
+			post.push_back({ lda, addr });
+			post.push_back({ ldv, 0 });
+			vt.inTemp[vn] = addr;
+			vt.firstStart[vn] = -1;
+		}
+		if (addr != 0)
+		{
+			with.push_back({ lda, addr });
+			with.push_back({ ldv, 0 });
+		}
+	}
+
+	if (with.empty())
+	{
+		if (vt.values[vn].op != ldi && vt.firstStart[vn] < 0 && vt.inTemp[vn] == 0)
+		{
+			vt.firstStart[vn] = start;
+			vt.firstEnd[vn] = end;
+			vt.occurs.push_back(vn);
+		}
+		return;
+	}
+
+	// computations nested in the replaced code are gone; they complete in order, so they are the last ones recorded
+	while (!vt.occurs.empty() && vt.firstEnd[vt.occurs.back()] >= start)
+	{
+		vt.firstStart[vt.occurs.back()] = -1;
+		vt.occurs.pop_back();
+	}
+	for (int i = start; i <= end; i++)
+	{
+		edits.deleted[i] = true;
+		edits.before[i].clear();
+		edits.after[i].clear();
+	}
+	edits.before[start] = with;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		int editedLength(codeEdits &edits, int from, int to, int most)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline int compiler::editedLength(codeEdits &edits, int from, int to, int most)
+{
+	// counted up to most, so deeply nested code is not counted over and over
+	int len = 0;
+	for (int i = from; i <= to && len < most; i++)
+		len += (edits.deleted[i] ? 0 : 1) + (int)edits.before[i].size() + (int)edits.after[i].size();
+	return len;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void foldBranches(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::foldBranches(codeList &code)
+{
+	// a conditional jump on constants either always or never jumps, and a JTB on a constant
+	// jumps to the target of the entry it takes
+	codeEdits edits(code.size());
+	for (size_t i = 1; i < code.size(); i++)
+	{
+		bool taken;
+		if (code[i].op == jtb && code[i - 1].op == ldi)
+		{
+			edits.deleted[i - 1] = true;
+			code[i] = { jmp, code[i + 1 + ((unsigned)code[i - 1].arg < (unsigned)code[i].arg ? code[i - 1].arg : code[i].arg)].arg };
+			continue;
+		}
+		else if (code[i].op == jmz && code[i - 1].op == ldi)
+		{
+			edits.deleted[i - 1] = true;
+			taken = code[i - 1].arg == 0;
+		}
+		else if (code[i].op >= jeq && code[i].op <= jge && i > 1 && code[i - 1].op == ldi && code[i - 2].op == ldi)
+		{
+			int x = code[i - 2].arg, y = code[i - 1].arg;
+			edits.deleted[i - 2] = edits.deleted[i - 1] = true;
+			switch (code[i].op)
+			{
+			case jeq: taken = x == y; break;
+			case jne: taken = x != y; break;
+			case jlt: taken = x < y; break;
+			case jle: taken = x <= y; break;
+			case jgt: taken = x > y; break;
+			default:  taken = x >= y;
+			}
+		}
+		else
+			continue;
+		if (taken)
+			code[i].op = jmp;
+		else
+			edits.deleted[i] = true;
+	}
+	applyEdits(code, edits);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void removeUnreachable(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::removeUnreachable(codeList &code)
+{
+	vector<basicBlock> blocks;
+	buildBlocks(code, blocks);
+	vector<bool> reached(blocks.size(), false);
+	vector<int> work(1, 0);
+	reached[0] = true;
+	while (!work.empty())
+	{
+		int b = work.back();
+		work.pop_back();
+		for (size_t k = 0; k < blocks[b].succ.size(); k++)
+			if (!reached[blocks[b].succ[k]])
+			{
+				reached[blocks[b].succ[k]] = true;
+				work.push_back(blocks[b].succ[k]);
+			}
+	}
+
+	codeEdits edits(code.size());
+	for (size_t b = 0; b < blocks.size(); b++)
+		if (!reached[b])
+			for (int i = blocks[b].from; i < blocks[b].to; i++)
+				if (code[i].op != lbl) edits.deleted[i] = true;
+
+	// a JMP to the instruction that follows it anyway is dropped
+	for (size_t i = 0; i < code.size(); i++)
+		if (code[i].op == jmp && !edits.deleted[i])
+		{
+			size_t j = i + 1;
+			while (j < code.size() && (edits.deleted[j] || (code[j].op == lbl && code[j].arg != code[i].arg))) j++;
+			if (j < code.size() && code[j].op == lbl) edits.deleted[i] = true;
+		}
+	applyEdits(code, edits);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					bool removeDeadStores(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool compiler::removeDeadStores(codeList &code)
+{
+	// a store to a variable that is not live afterwards is removed together with the
+	// code computing its value, unless that code could fail on a division by zero or an index,
+	// or reads input; a procedure may use any variable, so all are live at a CAL and a RET,
+	// while those in a frame are not tracked
+	vector<basicBlock> blocks;
+	vector<int> top, storeFrom;
+	buildBlocks(code, blocks);
+	operandStarts(code, blocks, top, storeFrom);
+	int vars = varAreaSize + 1;
+
+	// address operand of every STO, -1 unless it is a single LDA
+	for (size_t i = 0; i < code.size(); i++)
+		if (code[i].op != sto || storeFrom[i] < 0 || code[storeFrom[i]].op != lda || top[i] != storeFrom[i] + 1) storeFrom[i] = -1;
+
+	// live variables at the end of each block
+	vector<vector<bool> > use(blocks.size(), vector<bool>(vars, false)), def = use, liveOut = use;
+	for (size_t b = 0; b < blocks.size(); b++)
+		for (int i = blocks[b].to - 1; i >= blocks[b].from; i--)
+			if (code[i].op == sto && storeFrom[i] >= 0)
+			{
+				use[b][code[storeFrom[i]].arg] = false;
+				def[b][code[storeFrom[i]].arg] = true;
+			}
+			else if (code[i].op == ldv && code[i - 1].op == lda)
+				use[b][code[i - 1].arg] = true;
+			else if (code[i].op == lop)
+			{
+				if (code[i + 1].op == lda) use[b][code[i + 1].arg] = true;	// the variable and the limit
+				if (code[i + 2].op == lda) use[b][code[i + 2].arg] = true;
+			}
+			else if ((code[i].op == ldv && code[i - 1].op != lla) || isCall(code[i].op) || code[i].op == ret)
+				use[b].assign(vars, true);
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (int b = (int)blocks.size() - 1; b >= 0; b--)
+			for (size_t k = 0; k < blocks[b].succ.size(); k++)
+			{
+				int s = blocks[b].succ[k];
+				for (int v = 0; v < vars; v++)
+					if (!liveOut[b][v] && (use[s][v] || (liveOut[s][v] && !def[s][v])))
+					{
+						liveOut[b][v] = true;
+						changed = true;
+					}
+			}
+	}
+
+	codeEdits edits(code.size());
+	bool removed = false;
+	for (size_t b = 0; b < blocks.size(); b++)
+	{
+		vector<bool> live = liveOut[b];
+		for (int i = blocks[b].to - 1; i >= blocks[b].from; i--)
+			if (code[i].op == sto && storeFrom[i] >= 0)
+			{
+				int addr = code[storeFrom[i]].arg;
+				bool safe = !live[addr];
+				for (int k = storeFrom[i]; k < i && safe; k++)
+					if ((code[k].op == dvd && !(code[k - 1].op == ldi && code[k - 1].arg != 0)) || code[k].op == chk || code[k].op == rdi) safe = false;
+				if (safe)
+				{
+					for (int k = storeFrom[i]; k <= i; k++) edits.deleted[k] = true;
+					i = storeFrom[i];
+					removed = true;
+				}
+				else
+					live[addr] = false;
+			}
+			else if (code[i].op == ldv && code[i - 1].op == lda)
+				live[code[i - 1].arg] = true;
+			else if (code[i].op == lop)
+			{
+				if (code[i + 1].op == lda) live[code[i + 1].arg] = true;	// the variable and the limit
+				if (code[i + 2].op == lda) live[code[i + 2].arg] = true;
+			}
+			else if ((code[i].op == ldv && code[i - 1].op != lla) || isCall(code[i].op) || code[i].op == ret)
+				live.assign(vars, true);
+	}
+	applyEdits(code, edits);
+	return removed;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void compactVariables(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::compactVariables(codeList &code)
+{
+	// variables and temporaries that are no longer referenced give up their slot; the arrays
+	// move down to follow them
+	vector<int> slot(varAreaSize + 1, 0);
+	for (size_t i = 0; i < code.size(); i++)
+		if (code[i].op == lda) slot[code[i].arg] = 1;
+	varAreaSize = 0;
+	for (size_t a = 1; a < slot.size(); a++)
+		if (slot[a] != 0) slot[a] = ++varAreaSize;
+	int arrayDelta = varAreaSize - lastEntry;
+	for (size_t i = 0; i < code.size(); i++)
+		if (code[i].op == lda) code[i].arg = slot[code[i].arg];
+		else if (code[i].op == ldx || code[i].op == stx || code[i].op == ldb) code[i].arg += arrayDelta;
+	for (int i = 1; i <= lastEntry; i++)
+		if (symTab[i].size > 0) symTab[i].address += arrayDelta;
+		else symTab[i].address = slot[symTab[i].address];
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//			void constIntOp(opCodes op, int num, codeList &out)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::constIntOp(opCodes op, int num, codeList &out)
+{
+	// cheapest code for TopOfStack MUL num or TopOfStack DVD num
+	int shift = 0;
+	while (num > 0 && shift < 30 && (1 << shift) < num) shift++;
+	if (num == 1)
+		return;
+	if (num > 1 && (1 << shift) == num)
+		out.push_back({ op == mul ? shl : sar, shift });
+	else if (op == mul)
+		out.push_back({ mli, num });
+	else if (num > 1)
+		out.push_back({ dvi, num });
+	else
+	{
+		out.push_back({ ldi, num }); // division by zero is left to fail at run time
+		out.push_back({ dvd, 0 });
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void reduceStrength(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void compiler::reduceStrength(codeList &code)
+{
+	// a MUL or DVD whose operand became a constant after value numbering
+	vector<basicBlock> blocks;
+	vector<int> top, below;
+	buildBlocks(code, blocks);
+	operandStarts(code, blocks, top, below);
+	codeEdits edits(code.size());
+	for (int i = 0; i < (int)code.size(); i++)
+	{
+		if ((code[i].op != mul && code[i].op != dvd) || top[i] < 0 || below[i] < 0) continue;
+		if (code[top[i]].op == ldi && top[i] == i - 1)
+		{
+			edits.deleted[i - 1] = edits.deleted[i] = true;
+			constIntOp(code[i].op, code[i - 1].arg, edits.after[i]);
+		}
+		else if (code[i].op == mul && code[below[i]].op == ldi && top[i] == below[i] + 1)
+		{
+			edits.deleted[below[i]] = edits.deleted[i] = true;
+			constIntOp(mul, code[below[i]].arg, edits.after[i]);
+		}
+	}
+	applyEdits(code, edits);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					bool reduceInduction(codeList &code)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool compiler::reduceInduction(codeList &code)
+{
+	// In a loop whose variable i is changed only by i := i + c, or by the LOP that closes it, the
+	// product i * k is kept in a temporary t: t := i * k before the loop and t := t + c * k after
+	// the update of i, or before the LOP.
+	// Done for one variable and constant at a time, and only where the loads saved per
+	// iteration outweigh the six instructions of the update; not in a loop with a CAL.
+	unordered_map<int, int> labelAt;
+	vector<basicBlock> blocks;
+	vector<int> top, below;
+	buildBlocks(code, blocks);
+	operandStarts(code, blocks, top, below);
+	for (int i = 0; i < (int)code.size(); i++)
+		if (code[i].op == lbl) labelAt[code[i].arg] = i;
+
+	for (int back = 0; back < (int)code.size(); back++)
+	{
+		if (!isJump(code[back].op) || isCall(code[back].op) || labelAt[code[back].arg] > back) continue;
+		int head = labelAt[code[back].arg];
+
+		// loop variables and the place of their only update
+		unordered_map<int, int> stores, update;
+		bool known = true;
+		for (int i = head; i < back && known; i++)
+			if (isCall(code[i].op))
+				known = false;
+			else if (code[i].op == sto)
+			{
+				if (below[i] < 0 || code[below[i]].op != lda || top[i] != below[i] + 1) { known = false; break; }
+				int addr = code[below[i]].arg;
+				stores[addr]++;
+				if (below[i] == i - 5 && code[i - 4].op == lda && code[i - 4].arg == addr && code[i - 3].op == ldv &&
+					code[i - 2].op == ldi && (code[i - 1].op == add || code[i - 1].op == sub))
+					update[addr] = i;
+			}
+			else if (code[i].op == lop)
+			{
+				if (code[i + 1].op != lda) { known = false; break; }
+				stores[code[i + 1].arg]++;
+			}
+		if (!known) continue;
+		if (code[back].op == lop && code[back + 1].op == lda)
+		{
+			stores[code[back + 1].arg]++;
+			update[code[back + 1].arg] = back;
+		}
+
+		// products i * k in the loop, weighted by the depth of the loops they are in
+		struct useRec { int from, to, var, num, weight; };
+		vector<useRec> uses;
+		for (int i = head; i < back; i++)
+		{
+			int var = -1, num = 0, len = 0;
+			if (i + 2 < back && code[i].op == lda && code[i + 1].op == ldv && (code[i + 2].op == mli || code[i + 2].op == shl))
+			{
+				var = code[i].arg; len = 3;
+				num = code[i + 2].op == mli ? code[i + 2].arg : 1 << code[i + 2].arg;
+			}
+			else if (i + 3 < back && code[i].op == lda && code[i + 1].op == ldv && code[i + 2].op == ldi && code[i + 3].op == mul)
+			{
+				var = code[i].arg; len = 4; num = code[i + 2].arg;
+			}
+			else if (i + 3 < back && code[i].op == ldi && code[i + 1].op == lda && code[i + 2].op == ldv && code[i + 3].op == mul)
+			{
+				var = code[i + 1].arg; len = 4; num = code[i].arg;
+			}
+			if (var < 0 || stores[var] != 1 || update.count(var) == 0 || (update[var] != back && update[var] - 5 <= i && i <= update[var])) continue;
+			int weight = 1;
+			for (int j = i; j < back; j++)
+				if (isJump(code[j].op) && !isCall(code[j].op) && labelAt[code[j].arg] <= i && labelAt[code[j].arg] > head) weight = 10;
+			uses.push_back({ i, i + len - 1, var, num, weight });
+		}
+
+		for (size_t u = 0; u < uses.size(); u++)
+		{
+			int saved = 0;
+			for (size_t v = u; v < uses.size(); v++)
+				if (uses[v].var == uses[u].var && uses[v].num == uses[u].num)
+					saved += uses[v].weight * (uses[v].to - uses[v].from - 1);
+			if (saved <= 6) continue;
+
+			int var = uses[u].var, num = uses[u].num, t = ++varAreaSize, upd = update[var];
+			int step = upd == back ? code[upd + 3].arg * num : code[upd - 2].arg * num * (code[upd - 1].op == add ? 1 : -1);
+			codeEdits edits(code.size());
+
+			// t := i * num before the loop, entered through a new label
+			codeList &pre = edits.before[head];
+			pre.push_back({ lbl, labelCount });
+			pre.push_back({ lda, t });
+			pre.push_back({ lda, var });
+			pre.push_back({ ldv, 0 });
+			constIntOp(mul, num, pre);
+			pre.push_back({ sto, 0 });
+			for (int i = 0; i < (int)code.size(); i++)
+				if (isJump(code[i].op) && code[i].arg == code[head].arg && (i < head || i > back)) code[i].arg = labelCount;
+			labelCount++;
+
+			// t := t + step after i := i + c, or before the LOP
+			codeList &post = upd == back ? edits.before[upd] : edits.after[upd];
+			post.push_back({ lda, t });
+			post.push_back({ lda, t });
+			post.push_back({ ldv, 0 });
+			post.push_back({ ldi, step });
+			post.push_back({ add, 0 });
+			post.push_back({ sto, 0 });
+
+			for (size_t v = u; v < uses.size(); v++)
+				if (uses[v].var == var && uses[v].num == num)
+				{
+					for (int i = uses[v].from; i <= uses[v].to; i++) edits.deleted[i] = true;
+					edits.after[uses[v].to].push_back({ lda, t });
+					edits.after[uses[v].to].push_back({ ldv, 0 });
+				}
+			applyEdits(code, edits);
+			return true;
+		}
+	}
+	return false;
+}
+
 /*=============================================================*/
 
 
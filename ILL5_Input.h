@@ -0,0 +1,163 @@
+#pragma once
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+/*	CLASS intReader
+
+The input of the ILL5 READ and EOF instructions: integers separated by blanks, tabs and line ends,
+read from a file or the standard input. A file is read in blocks of inputBlock bytes, and a
+number is converted in place by from_chars, so the reader keeps up with input of any size without
+a copy or an allocation per number. The standard input is read a line at a time instead, so that
+a READ from a terminal or a pipe goes on as soon as its line has come, not when a block is full.
+
+	intReader input;
+	if (input.open("numbers.txt"))			// nullptr or "" for the standard input
+		while (!input.atEnd() && input.next(value) == intReader::ok) ...
+
+*/
+
+#include <cstdio>
+#include <vector>
+#include <charconv>
+#include <cstring>
+
+using namespace std;
+
+#define inputBlock (1 << 20)	//bytes read at a time
+#define inputNumberMax 32		//longest number read, in characters
+
+/*=============================================================*/
+
+class intReader
+{
+public:
+	enum readStatus { ok, endOfInput, notNumber };
+
+	intReader(void) : file(nullptr), owned(false), byLine(false), buffer(inputBlock), pos(0), end(0), done(true) {}
+	~intReader() { close(); }
+
+	bool open(const char *name);
+	void close(void);
+	bool atEnd(void) { return !skipBlanks(); }	// nothing but blanks is left
+	readStatus next(int &value);
+
+private:
+	FILE *file;
+	bool owned;				// opened here, and closed here
+	bool byLine;			// the standard input, read a line at a time
+	vector<char> buffer;
+	size_t pos, end;		// next character, end of what has been read
+	bool done;				// the whole input has been read
+
+	static bool isBlank(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+	bool skipBlanks(void);
+	void refill(void);
+}; // class intReader
+
+/*==================================================================*/
+/*==================================================================*/
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						bool open(const char *name)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool intReader::open(const char *name)
+{
+	// the named file, or the standard input if there is no name
+	close();
+	if (name == nullptr || *name == '\0')
+		file = stdin;
+	else if ((file = fopen(name, "rb")) == nullptr)
+		return false;
+	else
+		owned = true;
+	byLine = !owned;
+	pos = end = 0;
+	done = false;
+	return true;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void close(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void intReader::close(void)
+{
+	if (owned) fclose(file);
+	file = nullptr;
+	owned = false;
+	done = true;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void refill(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void intReader::refill(void)
+{
+	// keep what has not been taken at the front of the buffer and read more after it
+	if (pos > 0)
+	{
+		memmove(buffer.data(), buffer.data() + pos, end - pos);
+		end -= pos;
+		pos = 0;
+	}
+	size_t n = 0;
+	if (!byLine)
+		n = fread(buffer.data() + end, 1, buffer.size() - end, file);
+	else if (buffer.size() - end > 1 && fgets(buffer.data() + end, (int)(buffer.size() - end), file) != nullptr)
+		n = strlen(buffer.data() + end);
+	if (n == 0) done = true;
+	end += n;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							bool skipBlanks(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool intReader::skipBlanks(void)
+{
+	// false if the input ends first
+	for (;;)
+	{
+		while (pos < end && isBlank(buffer[pos])) pos++;
+		if (pos < end) return true;
+		if (done) return false;
+		refill();
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						readStatus next(int &value)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline intReader::readStatus intReader::next(int &value)
+{
+	// a number must fit in an int and end at a blank or at the end of the input
+	if (!skipBlanks()) return endOfInput;
+
+	// a number that runs to the end of what has been read may go on in what has not
+	size_t stop = pos;
+	while (stop < end && stop - pos < inputNumberMax && !isBlank(buffer[stop])) stop++;
+	if (stop == end && !done) refill();
+	const char *first = buffer.data() + pos, *last = buffer.data() + end;
+	from_chars_result r = from_chars(first, last, value);
+	if (r.ec != errc() || (r.ptr == last ? !done : !isBlank(*r.ptr))) return notNumber;
+	pos = r.ptr - buffer.data();
+	return ok;
+}
@@ -1,3 +1,4 @@
+#pragma once
 #ifdef _MSC_VER
 #define _CRT_SECURE_NO_WARNINGS
 #endif
@@ -7,6 +8,16 @@ This program is an interpreter (evaluator) of an ILL5 sentence which consists of
 P-instructions. An ILL5 sentence is generated by the PROGRAM HLL5_Compiler or HLL6_Compiler. The result of a
 successful interpretation is displayed on screen, else an error message is displayed.
 
+The sentence is read from the object file, or taken from a codeStream while HLL6_Compiler is still
+producing it (see ILL5_Stream.h); execution then waits at an instruction not compiled yet, and
+stops if compilation fails before it.
+
+A program that reads input is asked for the file it reads, or given it by the codeStream
+constructor; without a name it reads the standard input.
+
+A recordRunner (see ILL5_Records.h) loads the code once and runs it again for each record of
+its input, with the variables cleared and the fields of the record bound to some of them.
+
 Let S stand for the run-time stack and TOS for the top of stack pointer. Then TopOfStack refers
 to S[TOS], and AboveTop refers to S[TOS+1].
 
@@ -27,6 +38,54 @@ NLN   print carrage-return and line-feed sequence
 HLT   halt execution of p-machine
 INT A push integer value A onto stack
 LDA A push address value A onto stack
+SHL A shift TopOfStack left by A bits
+SAR A divide TopOfStack by 2 to the power A with an arithmetic shift, rounding toward zero as DVD does
+MLI A multiply TopOfStack by A
+DVI A integer divide TopOfStack by A (A > 1); the loader replaces A by a magic multiplier and a shift
+JMP A continue at instruction A
+JMZ A pop the stack, continue at instruction A if the popped value is 0
+JEQ A pop two elements, continue at instruction A if the lower one is equal to the upper one
+JNE A, JLT A, JLE A, JGT A, JGE A   likewise for not equal, less, less or equal, greater, greater or equal
+JTB A pop the stack, continue at the target of the JMP that is the popped value's entry of the A + 1
+      JMPs that follow, the last one if the value is not from 0 to A - 1; the JMP is not run
+LOP A add the step to the variable and continue at instruction A if it is still at most the limit
+      (at least the limit for a step below 0), else after the operands of the LOP: an LDA or LLA of
+      the variable, an LDA or LLA of the limit and an LDI of the step, not 0, which are not run
+CHK A stop with an error unless 0 <= TopOfStack < A, the size of an array indexed by TopOfStack
+LDX A replace the top of stack by the element at address A + TopOfStack, A being where an array starts
+STX A store TopOfStack into the element at address A + BelowTop, pop the stack twice
+
+(An index is checked by a CHK before the LDX or STX it is used by, unless the compiler has proven
+it in range.)
+
+The bulk instructions work on whole arrays of A elements, given by the addresses where they start
+(pushed by LDA); they run SIMD kernels (see ILL5_Kernels.h).
+
+SUM A replace the address at TopOfStack by the sum of the array there
+MIN A, MAX A   likewise for its smallest and its largest element
+FIL A store TopOfStack into every element of the array at BelowTop, pop the stack twice
+VAD A pop the addresses c, a and b, b being TopOfStack, and set each element of the array at c to
+      that of the array at a plus that of the array at b
+VSB A, VML A   likewise for a minus b and a times b
+CPY A copy the array at TopOfStack into the array at BelowTop, pop the stack twice
+
+RDI   push the next integer of the input (see ILL5_Input.h); reading past its end is an error
+EOF   push 1 if nothing but blanks and line ends is left of the input, else 0
+
+Let FP stand for the frame pointer of the procedure running, 0 in the main program.
+
+CAL A push the address of the next instruction and FP, set FP to TOS, continue at instruction A
+ENT A push A cells of 0, the variables of the procedure
+RET A set TOS to FP, pop FP and the return address, continue there and pop the A arguments
+LLA A push FP + A, the address of a parameter (A < -1) or a variable (A > 0) of the procedure
+TCL A a CAL A by the procedure at A of itself, as the last thing it does: the arguments on top of the
+      stack, above the variables reserved by the ENT at A, take the place of its own, TOS is set
+      to FP and it goes on at A in the same frame, so that a recursion of this kind runs in
+      constant stack
+
+The stack holds stackMax + 1 cells. An interpreter made while interpreter::deepStack is set lets
+it grow as it is needed, up to deepStackMax + 1 cells, for deeper recursion. Going past either
+size is a stack overflow.
 
 (A push operation first increments TOS by 1 then puts argument into stack cell.
 A pop operation first grabs cell content then decrements TOS by 1.)
@@ -37,8 +96,14 @@ A pop operation first grabs cell content then decrements TOS by 1.)
 #include <iostream>
 #include <iomanip>
 #include <string>
-#define codeMax 500
-#define stackMax 500
+#include <vector>
+#include <cstring>
+#include "ILL5_Stream.h"
+#include "ILL5_Kernels.h"
+#include "ILL5_Input.h"
+#define codeMax 1048576	//largest program loaded from a file, as large as the compiler makes
+#define stackMax 65535	//the variables, the arrays after them, and the stack
+#define deepStackMax (1 << 24)	//as far as a deep stack may grow
 
 using namespace std;
 
@@ -48,28 +113,42 @@ class interpreter
 {
 public:
 	interpreter(void); // constructor
+	interpreter(codeStream &stream, const char *inputName = nullptr); // constructor, runs the code while it is being compiled
+	// READ takes its numbers from inputName, or the standard input if there is none
 	~interpreter() {}; // destructor not defined yet
 
+	static bool deepStack;	// set before an interpreter is made, its stack grows up to deepStackMax
+
 private:
+	friend class recordRunner;
+	friend class laneInterpreter;
+	interpreter(const char *objectName, ostream &out); // constructor, loads the code to run it by runRecord()
+
 	//The last code in this list MUST be 'nul'
-	enum opCodes { add, sub, mul, dvd, ldi, lda, ldv, prc, prs, nln, prn, sto, inc, eql, neq, lss, leq, gtr, geq, jmp, jmz, hlt, nul };
+	enum opCodes { add, sub, mul, dvd, ldi, lda, ldv, prc, prs, nln, prn, sto, inc, eql, neq, lss, leq, gtr, geq, jmp, jmz, shl, sar, mli, dvi, jeq, jne, jlt, jle, jgt, jge, ldx, stx, chk, vsm, vmn, vmx, vfl, vad, vsb, vml, vcp, rdi, eoi, cal, ent, ret, lla, tcl, jtb, lop, hlt, nul };
 
 	struct pInstruction
 	{
 		opCodes op;
 		int arg;
+		int aux; // set by the loader: shift and correction of a DVI
 	};
 	struct memoryType
 	{
-		pInstruction pCode[codeMax];
-		int s[stackMax];
+		vector<pInstruction> pCode;	// up to codeMax instructions from a file, as many as streamed from a compiler
+		vector<int> s;				// stackMax + 1 cells, more as a deep stack grows
+		int stackTop;				// tos may reach stackMax, or deepStackMax if the stack is deep
 	};
 	memoryType memory;
+	codeStream *stream;			// where more code comes from, if set
+	const bulkKernels::kernelSet &kernel;	// the widest SIMD kernels this processor runs
+	intReader input;			// what READ reads
+	ostream &out;				// what WRITE writes, and run-time errors
 
-	enum progStat { running, finished, stkchk, divchk, lowchk, opchk };
+	enum progStat { running, finished, stkchk, divchk, lowchk, opchk, cmpchk, idxchk, inpchk, eofchk };
 	struct registerType
 	{
-		int pc, tos;
+		int pc, tos, fp;
 		progStat ps;
 	};
 	registerType reg;
@@ -81,34 +160,63 @@ private:
 	ifstream codeFile;
 
 	void getCodeFile(void);
+	void getInputFile(void);
 	void initMnemonic(void);
 	void skipLabel(char &ch);
 	void loadCode(void);
+	bool streamCode(void);
+	opCodes findOpCode(const char *thisCode);
+	bool hasArg(opCodes op);
+	bool magicDivisor(pInstruction &instr);
 	void dectBy(int i);
 	void inctBy(int i);
+	void growStack(void);
 	bool stackOkay(void);
 	void resetStack(void);
 	void postMortem(void);
+	static const char *statusText(progStat ps);
 	void initialize(void);
 	void nextStep(void);
 	void interpret(void);
+	void runRecord(const vector<int> &address, const vector<int> &value);
 	string generateString(void);
 }; // class interpreter
 
+inline bool interpreter::deepStack = false;
+
 /*==================================================================*/
 /*==================================================================*/
 
 //-----------//
 //CONSTRUCTOR//
 //-----------//
-interpreter::interpreter(void)
+inline interpreter::interpreter(void) : stream(nullptr), kernel(bulkKernels::kernels()), out(cout)
 {
 	getCodeFile();
 	initMnemonic();
 	loadCode();
+	if (hasErrors == false) getInputFile();
 	if (hasErrors == false) { cout << endl; interpret(); }
 } // interpreter
 
+inline interpreter::interpreter(codeStream &stream, const char *inputName) : stream(&stream), kernel(bulkKernels::kernels()), out(cout)
+{
+	initMnemonic();
+	hasErrors = !input.open(inputName);
+	if (hasErrors) out << "Input file " << inputName << " cannot be opened." << endl;
+	else interpret();
+	stream.stop();
+} // interpreter
+
+inline interpreter::interpreter(const char *objectName, ostream &out) : stream(nullptr), kernel(bulkKernels::kernels()), out(out)
+{
+	codeFile.open(objectName);
+	initMnemonic();
+	if (!codeFile) { out << "Object file " << objectName << " cannot be opened." << endl; hasErrors = true; }
+	else loadCode();
+	initialize();
+} // interpreter
+
 //*******************************************************************//
 //*******************************************************************//
 //
@@ -116,7 +224,7 @@ interpreter::interpreter(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::getCodeFile(void)
+inline void interpreter::getCodeFile(void)
 {
 	char str[20];
 	cout << endl << " === ILL5 Interpreter === " << endl << endl;
@@ -129,6 +237,30 @@ void interpreter::getCodeFile(void)
 	} while (!codeFile);
 }
 
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void getInputFile(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void interpreter::getInputFile(void)
+{
+	// asked for only if the program reads; no name reads the standard input
+	string name;
+	bool reads = false;
+	for (size_t i = 0; i < memory.pCode.size(); i++)
+		if (memory.pCode[i].op == rdi || memory.pCode[i].op == eoi) reads = true;
+	if (!reads) return;
+	cout << endl << "INPUT FILE    : ";
+	getline(cin, name);
+	while (!input.open(name.c_str()))
+	{
+		cout << "Input file " << name << " cannot be opened." << endl << "INPUT FILE    : ";
+		if (!getline(cin, name)) { hasErrors = true; return; }
+	}
+}
+
 //*******************************************************************//
 //*******************************************************************//
 //
@@ -136,31 +268,61 @@ void interpreter::getCodeFile(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::initMnemonic(void)
+inline void interpreter::initMnemonic(void)
 {
-	strcpy_s(mnemonic[add], "ADD");
-	strcpy_s(mnemonic[sub], "SUB");
-	strcpy_s(mnemonic[mul], "MUL");
-	strcpy_s(mnemonic[dvd], "DVD");
-	strcpy_s(mnemonic[ldi], "LDI");
-	strcpy_s(mnemonic[lda], "LDA");
-	strcpy_s(mnemonic[ldv], "LDV");
-	strcpy_s(mnemonic[prc], "PRC");
-	strcpy_s(mnemonic[prs], "PRS");
-	strcpy_s(mnemonic[nln], "NLN");
-	strcpy_s(mnemonic[prn], "PRN");
-	strcpy_s(mnemonic[hlt], "HLT");
-	strcpy_s(mnemonic[sto], "STO");
-	strcpy_s(mnemonic[inc], "INT");
-	strcpy_s(mnemonic[eql], "EQL");
-	strcpy_s(mnemonic[neq], "NEQ");
-	strcpy_s(mnemonic[lss], "LSS");
-	strcpy_s(mnemonic[leq], "LEQ");
-	strcpy_s(mnemonic[gtr], "GTR");
-	strcpy_s(mnemonic[geq], "GEQ");
-	strcpy_s(mnemonic[jmp], "JMP");
-	strcpy_s(mnemonic[jmz], "JMZ");
-	strcpy_s(mnemonic[nul], "NUL");
+	strcpy(mnemonic[add], "ADD");
+	strcpy(mnemonic[sub], "SUB");
+	strcpy(mnemonic[mul], "MUL");
+	strcpy(mnemonic[dvd], "DVD");
+	strcpy(mnemonic[ldi], "LDI");
+	strcpy(mnemonic[lda], "LDA");
+	strcpy(mnemonic[ldv], "LDV");
+	strcpy(mnemonic[prc], "PRC");
+	strcpy(mnemonic[prs], "PRS");
+	strcpy(mnemonic[nln], "NLN");
+	strcpy(mnemonic[prn], "PRN");
+	strcpy(mnemonic[hlt], "HLT");
+	strcpy(mnemonic[sto], "STO");
+	strcpy(mnemonic[inc], "INT");
+	strcpy(mnemonic[eql], "EQL");
+	strcpy(mnemonic[neq], "NEQ");
+	strcpy(mnemonic[lss], "LSS");
+	strcpy(mnemonic[leq], "LEQ");
+	strcpy(mnemonic[gtr], "GTR");
+	strcpy(mnemonic[geq], "GEQ");
+	strcpy(mnemonic[jmp], "JMP");
+	strcpy(mnemonic[jmz], "JMZ");
+	strcpy(mnemonic[shl], "SHL");
+	strcpy(mnemonic[sar], "SAR");
+	strcpy(mnemonic[mli], "MLI");
+	strcpy(mnemonic[dvi], "DVI");
+	strcpy(mnemonic[jeq], "JEQ");
+	strcpy(mnemonic[jne], "JNE");
+	strcpy(mnemonic[jlt], "JLT");
+	strcpy(mnemonic[jle], "JLE");
+	strcpy(mnemonic[jgt], "JGT");
+	strcpy(mnemonic[jge], "JGE");
+	strcpy(mnemonic[ldx], "LDX");
+	strcpy(mnemonic[stx], "STX");
+	strcpy(mnemonic[chk], "CHK");
+	strcpy(mnemonic[vsm], "SUM");
+	strcpy(mnemonic[vmn], "MIN");
+	strcpy(mnemonic[vmx], "MAX");
+	strcpy(mnemonic[vfl], "FIL");
+	strcpy(mnemonic[vad], "VAD");
+	strcpy(mnemonic[vsb], "VSB");
+	strcpy(mnemonic[vml], "VML");
+	strcpy(mnemonic[vcp], "CPY");
+	strcpy(mnemonic[rdi], "RDI");
+	strcpy(mnemonic[eoi], "EOF");
+	strcpy(mnemonic[cal], "CAL");
+	strcpy(mnemonic[ent], "ENT");
+	strcpy(mnemonic[ret], "RET");
+	strcpy(mnemonic[lla], "LLA");
+	strcpy(mnemonic[tcl], "TCL");
+	strcpy(mnemonic[jtb], "JTB");
+	strcpy(mnemonic[lop], "LOP");
+	strcpy(mnemonic[nul], "NUL");
 }
 
 /* ----------------------------------------- the Code Loader -------------------------------------------*/
@@ -172,7 +334,7 @@ void interpreter::initMnemonic(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void ReadLn(istream &istr)
+inline void ReadLn(istream &istr)
 {
 	// discard current line in the stream
 	char ch;
@@ -188,7 +350,7 @@ void ReadLn(istream &istr)
 //
 //*******************************************************************//
 //*******************************************************************//
-int Eoln(istream &istr)
+inline int Eoln(istream &istr)
 {
 	// check if the rest of the line is empty
 	char ch;
@@ -206,7 +368,7 @@ int Eoln(istream &istr)
 //
 //*******************************************************************//
 //*******************************************************************//
-void upperCase(char &ch)
+inline void upperCase(char &ch)
 {
 	if (ch >= 'a' && ch <= 'z') { ch = ch - 'a' + 'A'; }
 }
@@ -218,7 +380,7 @@ void upperCase(char &ch)
 //
 //*******************************************************************//
 //*******************************************************************//
-int isLetter(char ch)
+inline int isLetter(char ch)
 {
 	if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z'))
 		return true;
@@ -233,7 +395,7 @@ int isLetter(char ch)
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::skipLabel(char &ch)
+inline void interpreter::skipLabel(char &ch)
 {
 	do
 	{
@@ -248,23 +410,27 @@ void interpreter::skipLabel(char &ch)
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::loadCode(void)
+inline void interpreter::loadCode(void)
 {
+	// the code is as long as the file, with a NUL after it
 	char ch = ' ';
-	int i, nextCode = 0;
+	int nextCode = 0;
 	shortString thisCode;
 	hasErrors = false;
-	for (i = 0; i <= codeMax; i++)
-	{
-		memory.pCode[i].op = nul; // fill the rest with invalid op-code
-		memory.pCode[i].arg = 0;
-	}
+	memory.pCode.clear();
 
 	while (!codeFile.eof())
 	{
 		skipLabel(ch);
 		if (!codeFile.eof())
 		{
+			if (nextCode == codeMax)
+			{
+				out << "Code too large, over " << codeMax << " instructions" << endl;
+				hasErrors = true;
+				break;
+			}
+			memory.pCode.push_back({ nul, 0, 0 });
 			upperCase(ch);
 			thisCode[0] = ch;
 			for (int i = 1; i <= 2; ++i)
@@ -273,36 +439,124 @@ void interpreter::loadCode(void)
 			}
 			thisCode[3] = '\0';
 
-			memory.pCode[nextCode].op = add; // prepare to search op-code
-			strcpy_s(mnemonic[nul], thisCode);
-			while (strcmp(thisCode, mnemonic[memory.pCode[nextCode].op]) != false)
-			{
-				memory.pCode[nextCode].op = opCodes(memory.pCode[nextCode].op + 1);
-			}
+			memory.pCode[nextCode].op = findOpCode(thisCode);
 			if (memory.pCode[nextCode].op == nul)
 			{
-				cout << "Invalid op-code " << thisCode << " at " << nextCode << endl;
+				out << "Invalid op-code " << thisCode << " at " << nextCode << endl;
 				hasErrors = true;
 			}
-			if (memory.pCode[nextCode].op == ldi || memory.pCode[nextCode].op == inc || memory.pCode[nextCode].op == lda || memory.pCode[nextCode].op == jmz || memory.pCode[nextCode].op == jmp)
+			if (hasArg(memory.pCode[nextCode].op))
 				if (Eoln(codeFile) == true)
 				{
-					cout << "Missing operand at instr " << nextCode << endl;
+					out << "Missing operand at instr " << nextCode << endl;
 					hasErrors = true;
 				}
 				else
 					codeFile >> memory.pCode[nextCode].arg;
+			if (memory.pCode[nextCode].op == dvi && magicDivisor(memory.pCode[nextCode]) == false)
+			{
+				out << "Invalid divisor at instr " << nextCode << endl;
+				hasErrors = true;
+			}
 
 			ReadLn(codeFile);
+			nextCode++;
 		} // if
-		nextCode = (nextCode + 1) % codeMax;
 	}
+	memory.pCode.push_back({ nul, 0, 0 }); // running past the end is an invalid op-code
+} // loadCode
 
-	for (int ii = nextCode; ii <= codeMax; ii++)
+//*******************************************************************//
+//*******************************************************************//
+//
+//					opCodes findOpCode(const char *thisCode)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline interpreter::opCodes interpreter::findOpCode(const char *thisCode)
+{
+	// the op-code of a mnemonic, nul if there is none
+	opCodes op = add; // prepare to search op-code
+	strcpy(mnemonic[nul], thisCode);
+	while (strcmp(thisCode, mnemonic[op]) != false)
 	{
-		memory.pCode[ii].op = nul; // fill the rest with invalid op-code
+		op = opCodes(op + 1);
 	}
-} // loadCode
+	return op;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						bool streamCode(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool interpreter::streamCode(void)
+{
+	// load code from the stream until the instruction at pc has been compiled;
+	// false if the stream ends first
+	codeStream::instruction batch[256];
+	size_t n;
+	while (stream != nullptr && reg.pc >= (int)memory.pCode.size() && (n = stream->take(batch, 256)) > 0)
+		for (size_t k = 0; k < n; k++)
+		{
+			pInstruction instr = { findOpCode(batch[k].op), batch[k].arg, 0 };
+			if (instr.op == dvi && magicDivisor(instr) == false) instr.op = nul;
+			memory.pCode.push_back(instr);
+		}
+	return reg.pc < (int)memory.pCode.size();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						bool hasArg(opCodes op)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool interpreter::hasArg(opCodes op)
+{
+	return op == ldi || op == inc || op == lda || op == jmz || op == jmp || (op >= shl && op <= vcp) || (op >= cal && op <= lop);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					bool magicDivisor(pInstruction &instr)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool interpreter::magicDivisor(pInstruction &instr)
+{
+	// Replace the divisor d of a DVI by the multiplier m and shift p for which n / d equals
+	// the high word of m * n shifted right by p, corrected toward zero (Hacker's Delight 10-1).
+	int d = instr.arg;
+	if (d > -2 && d < 2) return false;
+
+	const unsigned two31 = 0x80000000u;
+	unsigned ad = d < 0 ? 0u - (unsigned)d : (unsigned)d;
+	unsigned t = two31 + ((unsigned)d >> 31);
+	unsigned anc = t - 1 - t % ad;
+	unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+	unsigned q2 = two31 / ad, r2 = two31 - q2 * ad, delta;
+	int p = 31;
+	do
+	{
+		p++;
+		q1 = 2 * q1; r1 = 2 * r1;
+		if (r1 >= anc) { q1++; r1 -= anc; }
+		q2 = 2 * q2; r2 = 2 * r2;
+		if (r2 >= ad) { q2++; r2 -= ad; }
+		delta = ad - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+
+	int m = (int)(q2 + 1);
+	if (d < 0) m = -m;
+	instr.arg = m;
+	instr.aux = (p - 32) | (d > 0 && m < 0 ? 0x100 : 0) | (d < 0 && m > 0 ? 0x200 : 0);
+	return true;
+}
 
 /* ----------------------------------------- Interpreter Engine -------------------------------------------*/
 
@@ -313,13 +567,35 @@ void interpreter::loadCode(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::interpret(void)
+inline void interpreter::interpret(void)
 {
 	initialize();
 	do{ nextStep(); } while (reg.ps == running);
 	if (reg.ps != finished) postMortem();
 }
 
+//*******************************************************************//
+//*******************************************************************//
+//
+//	void runRecord(const vector<int> &address, const vector<int> &value)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void interpreter::runRecord(const vector<int> &address, const vector<int> &value)
+{
+	// run the loaded code again from the start: only the variables and arrays, which the INT
+	// at the start reserves, are cleared, then value[k] is stored at address[k] unless that is 0
+	int area = memory.pCode[0].op == inc ? min(memory.pCode[0].arg, stackMax) : 0;
+	fill(memory.s.begin() + 1, memory.s.begin() + 1 + area, 0);
+	for (size_t k = 0; k < address.size(); k++)
+		if (address[k] > 0 && address[k] <= area) memory.s[address[k]] = value[k];
+	resetStack();
+	reg.pc = 0;
+	reg.ps = running;
+	do{ nextStep(); } while (reg.ps == running);
+	if (reg.ps != finished) postMortem();
+}
+
 //*******************************************************************//
 //*******************************************************************//
 //
@@ -327,8 +603,10 @@ void interpreter::interpret(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::initialize(void)
+inline void interpreter::initialize(void)
 {
+	memory.s.resize(stackMax + 1);
+	memory.stackTop = deepStack ? deepStackMax : stackMax;
 	for (int i = 0; i <= stackMax; i++)
 	{
 		memory.s[i] = 0; // clear stack
@@ -345,7 +623,7 @@ void interpreter::initialize(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::dectBy(int i) // decrement stack pointer, check for underflow
+inline void interpreter::dectBy(int i) // decrement stack pointer, check for underflow
 {
 	reg.tos = reg.tos - i;
 	if (reg.tos < 0) reg.ps = lowchk;
@@ -358,10 +636,25 @@ void interpreter::dectBy(int i) // decrement stack pointer, check for underflow
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::inctBy(int i) // increment stack pointer, check for overflow
+inline void interpreter::inctBy(int i) // increment stack pointer, check for overflow
 {
 	reg.tos = reg.tos + i;
-	if (reg.tos > stackMax) reg.ps = stkchk;
+	if (reg.tos > stackMax) growStack();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void growStack(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void interpreter::growStack(void)
+{
+	// past stackMax, by stackMax cells or as many as tos needs, but not past the top
+	if (reg.tos < (int)memory.s.size()) return;
+	if (reg.tos > memory.stackTop) { reg.ps = stkchk; return; }
+	memory.s.resize(min((size_t)memory.stackTop, max(memory.s.size() + stackMax, (size_t)reg.tos)) + 1, 0);
 }
 
 //*******************************************************************//
@@ -371,7 +664,7 @@ void interpreter::inctBy(int i) // increment stack pointer, check for overflow
 //
 //*******************************************************************//
 //*******************************************************************//
-bool interpreter::stackOkay(void) // check that stack pointer has not underflowed
+inline bool interpreter::stackOkay(void) // check that stack pointer has not underflowed
 {
 	if (reg.tos < 0) reg.ps = lowchk;
 	if (reg.ps == running)
@@ -387,7 +680,7 @@ bool interpreter::stackOkay(void) // check that stack pointer has not underflowe
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::resetStack(void) { reg.tos = 0; }
+inline void interpreter::resetStack(void) { reg.tos = 0; reg.fp = 0; }
 
 //*******************************************************************//
 //*******************************************************************//
@@ -396,17 +689,32 @@ void interpreter::resetStack(void) { reg.tos = 0; }
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::postMortem(void)
+inline void interpreter::postMortem(void)
 {
-	cout << "Error: ";
-	switch (reg.ps)
+	out << "Error: " << statusText(reg.ps) << " at instruction " << (reg.pc - 1) << "." << endl;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					const char *statusText(progStat ps)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline const char *interpreter::statusText(progStat ps)
+{
+	switch (ps)
 	{
-	case stkchk: cout << "Stack overflow"; break;
-	case lowchk: cout << "Stack underflow"; break;
-	case divchk: cout << "Can't divide by zero"; break;
-	case opchk:  cout << "Invalid op-code"; break;
+	case stkchk: return "Stack overflow";
+	case lowchk: return "Stack underflow";
+	case divchk: return "Can't divide by zero";
+	case opchk:  return "Invalid op-code";
+	case cmpchk: return "Compilation stopped";
+	case idxchk: return "Index out of range";
+	case inpchk: return "Input is not an integer";
+	case eofchk: return "Read past the end of input";
+	default:     return "";
 	}
-	cout << " at instruction " << (reg.pc - 1) << "." << endl;
 }
 
 //*******************************************************************//
@@ -416,7 +724,7 @@ void interpreter::postMortem(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-string interpreter::generateString(void)
+inline string interpreter::generateString(void)
 {
 	string returnString;
 	int moveAmount = memory.s[reg.tos];
@@ -438,25 +746,36 @@ string interpreter::generateString(void)
 //
 //*******************************************************************//
 //*******************************************************************//
-void interpreter::nextStep(void)
+inline void interpreter::nextStep(void)
 {
 	pInstruction i;
+	if (reg.pc >= (int)memory.pCode.size() && streamCode() == false)
+	{
+		reg.pc = reg.pc + 1;
+		reg.ps = stream != nullptr && stream->compiled() == false ? cmpchk : opchk;
+		return;
+	}
 	i = memory.pCode[reg.pc];
 	reg.pc = reg.pc + 1; // fetch next p-instruction
 	switch (i.op)
 	{
 	case nul: reg.ps = opchk; break;
 	case add: dectBy(1);
-		if (reg.ps == running) memory.s[reg.tos] = memory.s[reg.tos] + memory.s[reg.tos + 1]; break;
+		if (reg.ps == running) memory.s[reg.tos] = memory.s[reg.tos] + memory.s[reg.tos + 1];
+		break;
 	case sub: dectBy(1);
-		if (reg.ps == running) memory.s[reg.tos] = memory.s[reg.tos] - memory.s[reg.tos + 1]; break;
+		if (reg.ps == running) memory.s[reg.tos] = memory.s[reg.tos] - memory.s[reg.tos + 1];
+		break;
 	case mul: dectBy(1);
-		if (reg.ps == running) memory.s[reg.tos] = memory.s[reg.tos] * memory.s[reg.tos + 1]; break;
+		if (reg.ps == running) memory.s[reg.tos] = memory.s[reg.tos] * memory.s[reg.tos + 1];
+		break;
 	case dvd: dectBy(1);
 		if (reg.ps == running)
+		{
 			if (memory.s[reg.tos + 1] == 0) reg.ps = divchk;
 			else memory.s[reg.tos] = int(memory.s[reg.tos] / memory.s[reg.tos + 1]);
-			break;
+		}
+		break;
 	case eql: dectBy(1);
 		if (memory.s[reg.tos] == memory.s[reg.tos + 1])
 			memory.s[reg.tos] = 1;
@@ -494,53 +813,192 @@ void interpreter::nextStep(void)
 			memory.s[reg.tos] = 0;
 		break;
 	case ldi: case lda: inctBy(1);
-		if (reg.ps == running) memory.s[reg.tos] = i.arg; break;
+		if (reg.ps == running) memory.s[reg.tos] = i.arg;
+		break;
 	case ldv:
-		if (reg.ps == running) memory.s[reg.tos] = memory.s[memory.s[reg.tos]]; break;
+		if (reg.ps == running) memory.s[reg.tos] = memory.s[memory.s[reg.tos]];
+		break;
+	case shl:
+		memory.s[reg.tos] = (int)((unsigned)memory.s[reg.tos] << i.arg);
+		break;
+	case sar:
+	{
+		int n = memory.s[reg.tos];
+		memory.s[reg.tos] = (n + ((n >> 31) & ((1 << i.arg) - 1))) >> i.arg;
+		break;
+	}
+	case mli:
+		memory.s[reg.tos] = (int)((unsigned)memory.s[reg.tos] * (unsigned)i.arg);
+		break;
+	case dvi:
+	{
+		int n = memory.s[reg.tos];
+		int q = (int)(((long long)i.arg * n) >> 32);
+		if (i.aux & 0x100) q += n;
+		if (i.aux & 0x200) q -= n;
+		q >>= (i.aux & 0xff);
+		memory.s[reg.tos] = q + (int)((unsigned)q >> 31);
+		break;
+	}
 	case sto: dectBy(1);
 		if (reg.ps == running) memory.s[memory.s[reg.tos]] = memory.s[reg.tos + 1];
-		dectBy(1);  break;
+		dectBy(1);
+		break;
 	case inc: inctBy(i.arg); break;
+	case chk:
+		if (memory.s[reg.tos] < 0 || memory.s[reg.tos] >= i.arg) reg.ps = idxchk;
+		break;
+	case ldx:
+		memory.s[reg.tos] = memory.s[i.arg + memory.s[reg.tos]];
+		break;
+	case stx: dectBy(2);
+		if (reg.ps == running) memory.s[i.arg + memory.s[reg.tos + 1]] = memory.s[reg.tos + 2];
+		break;
+	case vsm:
+		memory.s[reg.tos] = kernel.sum(&memory.s[memory.s[reg.tos]], i.arg);
+		break;
+	case vmn:
+		memory.s[reg.tos] = kernel.min(&memory.s[memory.s[reg.tos]], i.arg);
+		break;
+	case vmx:
+		memory.s[reg.tos] = kernel.max(&memory.s[memory.s[reg.tos]], i.arg);
+		break;
+	case vfl: dectBy(2);
+		if (reg.ps == running) kernel.fill(&memory.s[memory.s[reg.tos + 1]], i.arg, memory.s[reg.tos + 2]);
+		break;
+	case vad: dectBy(3);
+		if (reg.ps == running) kernel.add(&memory.s[memory.s[reg.tos + 1]], &memory.s[memory.s[reg.tos + 2]], &memory.s[memory.s[reg.tos + 3]], i.arg);
+		break;
+	case vsb: dectBy(3);
+		if (reg.ps == running) kernel.sub(&memory.s[memory.s[reg.tos + 1]], &memory.s[memory.s[reg.tos + 2]], &memory.s[memory.s[reg.tos + 3]], i.arg);
+		break;
+	case vml: dectBy(3);
+		if (reg.ps == running) kernel.mul(&memory.s[memory.s[reg.tos + 1]], &memory.s[memory.s[reg.tos + 2]], &memory.s[memory.s[reg.tos + 3]], i.arg);
+		break;
+	case vcp: dectBy(2);
+		if (reg.ps == running) memmove(&memory.s[memory.s[reg.tos + 1]], &memory.s[memory.s[reg.tos + 2]], i.arg * sizeof(int));
+		break;
+	case rdi: inctBy(1);
+		if (reg.ps == running)
+			switch (input.next(memory.s[reg.tos]))
+			{
+			case intReader::ok: break;
+			case intReader::endOfInput: reg.ps = eofchk; break;
+			case intReader::notNumber: reg.ps = inpchk; break;
+			}
+		break;
+	case eoi: inctBy(1);
+		if (reg.ps == running) memory.s[reg.tos] = input.atEnd() ? 1 : 0;
+		break;
+	case cal: inctBy(2);
+		if (reg.ps == running)
+		{
+			memory.s[reg.tos - 1] = reg.pc;
+			memory.s[reg.tos] = reg.fp;
+			reg.fp = reg.tos;
+			reg.pc = i.arg;
+		}
+		break;
+	case ent: inctBy(i.arg);
+		if (reg.ps == running) fill(memory.s.begin() + reg.tos - i.arg + 1, memory.s.begin() + reg.tos + 1, 0);
+		break;
+	case ret:
+		if (reg.fp < 2) { reg.ps = lowchk; break; }	// not in a procedure
+		reg.tos = reg.fp;
+		reg.pc = memory.s[reg.tos - 1];
+		reg.fp = memory.s[reg.tos];
+		dectBy(2 + i.arg);
+		break;
+	case lla: inctBy(1);
+		if (reg.ps == running) memory.s[reg.tos] = reg.fp + i.arg;
+		break;
+	case tcl:
+	{
+		int args = i.arg < (int)memory.pCode.size() && memory.pCode[i.arg].op == ent ? reg.tos - reg.fp - memory.pCode[i.arg].arg : -1;
+		if (args < 0 || reg.fp - 1 - args < 1) { reg.ps = lowchk; break; }
+		copy(memory.s.begin() + reg.tos - args + 1, memory.s.begin() + reg.tos + 1, memory.s.begin() + reg.fp - 1 - args);
+		reg.tos = reg.fp;
+		reg.pc = i.arg;
+		break;
+	}
 	case jmp:
-		int jmpLocation;
-		jmpLocation = i.arg;
-		if (jmpLocation > reg.pc)
-			while (reg.pc != jmpLocation)
-				reg.pc = reg.pc + 1;
-		if (jmpLocation < reg.pc)
-			while (reg.pc != jmpLocation)
-				reg.pc = reg.pc - 1;
+		reg.pc = i.arg;
 		break;
-	case jmz:
-		if (memory.s[reg.tos] == 0)
+	case jtb: dectBy(1);
+	{
+		// the table follows the JTB, and is taken from the stream if it has not come in with it
+		int v = memory.s[reg.tos + 1], at = reg.pc;
+		if (reg.ps != running) break;
+		reg.pc += (unsigned)v < (unsigned)i.arg ? v : i.arg;
+		if ((reg.pc >= (int)memory.pCode.size() && streamCode() == false) || memory.pCode[reg.pc].op != jmp)
 		{
-			int jmzLocation = i.arg;
-			if (jmzLocation > reg.pc)
-				while (reg.pc != jmzLocation)
-					reg.pc = reg.pc + 1;
-			if (jmzLocation < reg.pc)
-				while (reg.pc != jmzLocation)
-					reg.pc = reg.pc - 1;
+			reg.pc = at;
+			reg.ps = opchk;
+		}
+		else
+			reg.pc = memory.pCode[reg.pc].arg;
+		break;
+	}
+	case lop:
+	{
+		// the operands follow the LOP, and are taken from the stream if they have not come in with it
+		int at = reg.pc;
+		reg.pc = at + 2;
+		if (reg.pc >= (int)memory.pCode.size() && streamCode() == false) { reg.pc = at; reg.ps = opchk; break; }
+		const pInstruction *w = &memory.pCode[at];
+		if ((w[0].op != lda && w[0].op != lla) || (w[1].op != lda && w[1].op != lla) || w[2].op != ldi || w[2].arg == 0)
+		{
+			reg.pc = at;
+			reg.ps = opchk;
+			break;
 		}
+		int &v = memory.s[w[0].op == lla ? reg.fp + w[0].arg : w[0].arg];
+		int limit = memory.s[w[1].op == lla ? reg.fp + w[1].arg : w[1].arg];
+		long long next = (long long)v + w[2].arg;	// past INT_MAX or INT_MIN the loop ends, it does not wrap
+		v = (int)next;
+		reg.pc = (w[2].arg > 0 ? next <= limit : next >= limit) ? i.arg : at + 3;
+		break;
+	}
+	case jmz:
+		if (memory.s[reg.tos] == 0) reg.pc = i.arg;
 		dectBy(1);
 		break;
+	case jeq: dectBy(2);
+		if (reg.ps == running && memory.s[reg.tos + 1] == memory.s[reg.tos + 2]) reg.pc = i.arg;
+		break;
+	case jne: dectBy(2);
+		if (reg.ps == running && memory.s[reg.tos + 1] != memory.s[reg.tos + 2]) reg.pc = i.arg;
+		break;
+	case jlt: dectBy(2);
+		if (reg.ps == running && memory.s[reg.tos + 1] < memory.s[reg.tos + 2]) reg.pc = i.arg;
+		break;
+	case jle: dectBy(2);
+		if (reg.ps == running && memory.s[reg.tos + 1] <= memory.s[reg.tos + 2]) reg.pc = i.arg;
+		break;
+	case jgt: dectBy(2);
+		if (reg.ps == running && memory.s[reg.tos + 1] > memory.s[reg.tos + 2]) reg.pc = i.arg;
+		break;
+	case jge: dectBy(2);
+		if (reg.ps == running && memory.s[reg.tos + 1] >= memory.s[reg.tos + 2]) reg.pc = i.arg;
+		break;
 	case prn:
-		if (stackOkay() == true) cout << memory.s[reg.tos];
+		if (stackOkay() == true) out << memory.s[reg.tos];
 		dectBy(1);
 		break;
 	case prs:
-		if (stackOkay() == true) cout << generateString(); break;
+		if (stackOkay() == true) out << generateString();
+		break;
 	case prc:
 		if (stackOkay() == true)
 		{
 			char printChar = memory.s[reg.tos];
-			cout << printChar;
+			out << printChar;
 			dectBy(1);
 		}
 		break;
 	case nln:
 		if (stackOkay() == true)
-			cout << endl;
+			out << endl;
 		break;
 	case hlt: reg.ps = finished; break;
 	}
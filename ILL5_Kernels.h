@@ -0,0 +1,331 @@
+#pragma once
+/*	CLASS bulkKernels
+
+The loops behind the ILL5 bulk instructions, which work on whole arrays: SUM, MIN and MAX reduce
+an array to a number, FIL fills it, and VAD, VSB and VML add, subtract and multiply two arrays
+element by element. Arithmetic wraps around as it does in 32-bit two's complement.
+
+On x86-64, and on 32-bit x86 built for SSE2, each kernel comes in an AVX2 and an SSE2 version,
+besides the plain one; the first call of kernels() picks the widest the processor supports, and
+the interpreter keeps the set it was given. Elsewhere only the plain kernels are built.
+
+	const bulkKernels::kernelSet &k = bulkKernels::kernels();
+	int total = k.sum(a, n);
+
+*/
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define bulkSimd 1			//SSE2 and AVX2 kernels are built, where SSE2 is sure to be there
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define bulkAvx2				//MSVC needs no target attribute for AVX2 code
+#else
+#define bulkAvx2 __attribute__((target("avx2")))
+#endif
+#else
+#define bulkSimd 0
+#endif
+
+using namespace std;
+
+/*=============================================================*/
+
+class bulkKernels
+{
+public:
+	struct kernelSet
+	{
+		const char *name;
+		int (*sum)(const int *a, int n);
+		int (*min)(const int *a, int n);		// n > 0
+		int (*max)(const int *a, int n);		// n > 0
+		void (*fill)(int *a, int n, int v);
+		void (*add)(int *c, const int *a, const int *b, int n);		// c may be a or b
+		void (*sub)(int *c, const int *a, const int *b, int n);
+		void (*mul)(int *c, const int *a, const int *b, int n);
+	};
+
+	static const kernelSet &kernels(void);
+	static const kernelSet plain;
+#if bulkSimd
+	static const kernelSet sse2, avx2;
+#endif
+
+private:
+	static bool hasAvx2(void);
+
+	static int  sumPlain(const int *a, int n);
+	static int  minPlain(const int *a, int n);
+	static int  maxPlain(const int *a, int n);
+	static void fillPlain(int *a, int n, int v);
+	static void addPlain(int *c, const int *a, const int *b, int n);
+	static void subPlain(int *c, const int *a, const int *b, int n);
+	static void mulPlain(int *c, const int *a, const int *b, int n);
+#if bulkSimd
+	static __m128i min128(__m128i x, __m128i y) { __m128i gt = _mm_cmpgt_epi32(x, y); return _mm_or_si128(_mm_and_si128(gt, y), _mm_andnot_si128(gt, x)); }
+	static __m128i max128(__m128i x, __m128i y) { __m128i gt = _mm_cmpgt_epi32(x, y); return _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, y)); }
+	static int  sumSse2(const int *a, int n);
+	static int  minSse2(const int *a, int n);
+	static int  maxSse2(const int *a, int n);
+	static void fillSse2(int *a, int n, int v);
+	static void addSse2(int *c, const int *a, const int *b, int n);
+	static void subSse2(int *c, const int *a, const int *b, int n);
+	static void mulSse2(int *c, const int *a, const int *b, int n);
+	static int  sumAvx2(const int *a, int n);
+	static int  minAvx2(const int *a, int n);
+	static int  maxAvx2(const int *a, int n);
+	static void fillAvx2(int *a, int n, int v);
+	static void addAvx2(int *c, const int *a, const int *b, int n);
+	static void subAvx2(int *c, const int *a, const int *b, int n);
+	static void mulAvx2(int *c, const int *a, const int *b, int n);
+#endif
+}; // class bulkKernels
+
+inline const bulkKernels::kernelSet bulkKernels::plain = { "plain", sumPlain, minPlain, maxPlain, fillPlain, addPlain, subPlain, mulPlain };
+#if bulkSimd
+inline const bulkKernels::kernelSet bulkKernels::sse2 = { "SSE2", sumSse2, minSse2, maxSse2, fillSse2, addSse2, subSse2, mulSse2 };
+inline const bulkKernels::kernelSet bulkKernels::avx2 = { "AVX2", sumAvx2, minAvx2, maxAvx2, fillAvx2, addAvx2, subAvx2, mulAvx2 };
+#endif
+
+/*==================================================================*/
+/*==================================================================*/
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						const kernelSet &kernels(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline const bulkKernels::kernelSet &bulkKernels::kernels(void)
+{
+	// chosen once; SSE2 is part of every x86-64 processor
+#if bulkSimd
+	static const kernelSet &chosen = hasAvx2() ? avx2 : sse2;
+	return chosen;
+#else
+	return plain;
+#endif
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							bool hasAvx2(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool bulkKernels::hasAvx2(void)
+{
+	// the processor has AVX2 and the operating system saves the YMM registers
+#if !bulkSimd
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0) return false;	// OSXSAVE, AVX
+	if ((_xgetbv(0) & 6) != 6) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+/* ----------------------------------------- plain kernels -------------------------------------------*/
+
+inline int bulkKernels::sumPlain(const int *a, int n)
+{
+	uint32_t s = 0;
+	for (int i = 0; i < n; i++) s += (uint32_t)a[i];
+	return (int)s;
+}
+
+inline int bulkKernels::minPlain(const int *a, int n)
+{
+	int m = a[0];
+	for (int i = 1; i < n; i++) if (a[i] < m) m = a[i];
+	return m;
+}
+
+inline int bulkKernels::maxPlain(const int *a, int n)
+{
+	int m = a[0];
+	for (int i = 1; i < n; i++) if (a[i] > m) m = a[i];
+	return m;
+}
+
+inline void bulkKernels::fillPlain(int *a, int n, int v)
+{
+	for (int i = 0; i < n; i++) a[i] = v;
+}
+
+inline void bulkKernels::addPlain(int *c, const int *a, const int *b, int n)
+{
+	for (int i = 0; i < n; i++) c[i] = (int)((uint32_t)a[i] + (uint32_t)b[i]);
+}
+
+inline void bulkKernels::subPlain(int *c, const int *a, const int *b, int n)
+{
+	for (int i = 0; i < n; i++) c[i] = (int)((uint32_t)a[i] - (uint32_t)b[i]);
+}
+
+inline void bulkKernels::mulPlain(int *c, const int *a, const int *b, int n)
+{
+	for (int i = 0; i < n; i++) c[i] = (int)((uint32_t)a[i] * (uint32_t)b[i]);
+}
+
+#if bulkSimd
+/* ----------------------------------------- SSE2 kernels, 4 elements at a time -------------------------------------------*/
+
+inline int bulkKernels::sumSse2(const int *a, int n)
+{
+	__m128i s = _mm_setzero_si128();
+	int i = 0;
+	for (; i + 4 <= n; i += 4) s = _mm_add_epi32(s, _mm_loadu_si128((const __m128i *)(a + i)));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+	s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (int)((uint32_t)_mm_cvtsi128_si32(s) + (uint32_t)sumPlain(a + i, n - i));
+}
+
+inline int bulkKernels::minSse2(const int *a, int n)
+{
+	if (n < 4) return minPlain(a, n);
+	__m128i m = _mm_loadu_si128((const __m128i *)a);
+	int i = 4;
+	for (; i + 4 <= n; i += 4) m = min128(m, _mm_loadu_si128((const __m128i *)(a + i)));
+	m = min128(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = min128(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	int r = _mm_cvtsi128_si32(m);
+	for (; i < n; i++) if (a[i] < r) r = a[i];
+	return r;
+}
+
+inline int bulkKernels::maxSse2(const int *a, int n)
+{
+	if (n < 4) return maxPlain(a, n);
+	__m128i m = _mm_loadu_si128((const __m128i *)a);
+	int i = 4;
+	for (; i + 4 <= n; i += 4) m = max128(m, _mm_loadu_si128((const __m128i *)(a + i)));
+	m = max128(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+	m = max128(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+	int r = _mm_cvtsi128_si32(m);
+	for (; i < n; i++) if (a[i] > r) r = a[i];
+	return r;
+}
+
+inline void bulkKernels::fillSse2(int *a, int n, int v)
+{
+	__m128i x = _mm_set1_epi32(v);
+	int i = 0;
+	for (; i + 4 <= n; i += 4) _mm_storeu_si128((__m128i *)(a + i), x);
+	fillPlain(a + i, n - i, v);
+}
+
+inline void bulkKernels::addSse2(int *c, const int *a, const int *b, int n)
+{
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_si128((__m128i *)(c + i), _mm_add_epi32(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i))));
+	addPlain(c + i, a + i, b + i, n - i);
+}
+
+inline void bulkKernels::subSse2(int *c, const int *a, const int *b, int n)
+{
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		_mm_storeu_si128((__m128i *)(c + i), _mm_sub_epi32(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i))));
+	subPlain(c + i, a + i, b + i, n - i);
+}
+
+inline void bulkKernels::mulSse2(int *c, const int *a, const int *b, int n)
+{
+	// SSE2 has no 32-bit MULLO; the even and the odd lanes are multiplied apart and put together
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)(a + i)), y = _mm_loadu_si128((const __m128i *)(b + i));
+		__m128i even = _mm_mul_epu32(x, y);
+		__m128i odd = _mm_mul_epu32(_mm_srli_epi64(x, 32), _mm_srli_epi64(y, 32));
+		__m128i lo = _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+		_mm_storeu_si128((__m128i *)(c + i), lo);
+	}
+	mulPlain(c + i, a + i, b + i, n - i);
+}
+
+/* ----------------------------------------- AVX2 kernels, 8 elements at a time -------------------------------------------*/
+
+bulkAvx2 inline int bulkKernels::sumAvx2(const int *a, int n)
+{
+	__m256i s = _mm256_setzero_si256();
+	int i = 0;
+	for (; i + 8 <= n; i += 8) s = _mm256_add_epi32(s, _mm256_loadu_si256((const __m256i *)(a + i)));
+	__m128i h = _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+	h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+	h = _mm_add_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+	return (int)((uint32_t)_mm_cvtsi128_si32(h) + (uint32_t)sumPlain(a + i, n - i));
+}
+
+bulkAvx2 inline int bulkKernels::minAvx2(const int *a, int n)
+{
+	if (n < 8) return minPlain(a, n);
+	__m256i m = _mm256_loadu_si256((const __m256i *)a);
+	int i = 8;
+	for (; i + 8 <= n; i += 8) m = _mm256_min_epi32(m, _mm256_loadu_si256((const __m256i *)(a + i)));
+	__m128i h = _mm_min_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+	h = _mm_min_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+	h = _mm_min_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+	int r = _mm_cvtsi128_si32(h);
+	for (; i < n; i++) if (a[i] < r) r = a[i];
+	return r;
+}
+
+bulkAvx2 inline int bulkKernels::maxAvx2(const int *a, int n)
+{
+	if (n < 8) return maxPlain(a, n);
+	__m256i m = _mm256_loadu_si256((const __m256i *)a);
+	int i = 8;
+	for (; i + 8 <= n; i += 8) m = _mm256_max_epi32(m, _mm256_loadu_si256((const __m256i *)(a + i)));
+	__m128i h = _mm_max_epi32(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+	h = _mm_max_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(1, 0, 3, 2)));
+	h = _mm_max_epi32(h, _mm_shuffle_epi32(h, _MM_SHUFFLE(2, 3, 0, 1)));
+	int r = _mm_cvtsi128_si32(h);
+	for (; i < n; i++) if (a[i] > r) r = a[i];
+	return r;
+}
+
+bulkAvx2 inline void bulkKernels::fillAvx2(int *a, int n, int v)
+{
+	__m256i x = _mm256_set1_epi32(v);
+	int i = 0;
+	for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i *)(a + i), x);
+	fillPlain(a + i, n - i, v);
+}
+
+bulkAvx2 inline void bulkKernels::addAvx2(int *c, const int *a, const int *b, int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_si256((__m256i *)(c + i), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i))));
+	addPlain(c + i, a + i, b + i, n - i);
+}
+
+bulkAvx2 inline void bulkKernels::subAvx2(int *c, const int *a, const int *b, int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_si256((__m256i *)(c + i), _mm256_sub_epi32(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i))));
+	subPlain(c + i, a + i, b + i, n - i);
+}
+
+bulkAvx2 inline void bulkKernels::mulAvx2(int *c, const int *a, const int *b, int n)
+{
+	int i = 0;
+	for (; i + 8 <= n; i += 8)
+		_mm256_storeu_si256((__m256i *)(c + i), _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i))));
+	mulPlain(c + i, a + i, b + i, n - i);
+}
+#endif
@@ -0,0 +1,645 @@
+#pragma once
+/*	CLASS laneInterpreter
+
+Runs the loaded code of an interpreter on laneCount inputs at once, one in each lane. Every cell
+of the memory holds laneCount values, one per lane, next to each other, so that an ADD or an LSS
+is a single loop over the lanes which the compiler turns into SIMD instructions; an instruction is
+dispatched once for all the lanes instead of once for each of them.
+
+The lanes share the program counter, the top of stack and the frame pointer. A conditional jump
+the lanes do not agree on splits them: those that jump run first, the others wait, and all of them
+go on together at the immediate post-dominator of the jump, the first instruction every path from
+it reaches, in the same frame; a JTB splits them into as many groups as they have targets. That
+point is computed once, when the code is taken over, with a CAL taken to go on to the next
+instruction and a RET to end the program; the splits pending are kept on a stack.
+Loads, stores and output are done only for the lanes that are running. A lane stopped by a
+run-time error writes the error to its own output, as the interpreter would, and the others go on.
+
+The bulk instructions run lane by lane, and READ has nothing to read: a laneInterpreter runs the
+records of a recordRunner (see ILL5_Records.h), laneCount of them at a time.
+
+	laneInterpreter lanes(loaded);				// an interpreter that has loaded the code
+	lanes.runRecords(address, value, n);		// value[l] is bound in lane l, for l < n
+	cout << lanes.output(0);
+
+*/
+
+#include <vector>
+#include <string>
+#include <charconv>
+#include "ILL5_Interpreter.h"
+
+using namespace std;
+
+#define laneCount 8			//inputs run at once, a multiple of the SIMD width
+
+/*=============================================================*/
+
+class laneInterpreter
+{
+public:
+	laneInterpreter(const interpreter &loaded);
+	~laneInterpreter() {}
+
+	// value[l] is stored at address, as runRecord() does, in lane l for l < lanes
+	void runRecords(const vector<int> &address, const vector<vector<int> > &value, int lanes);
+	const string &output(int lane) { return screen[lane]; }
+
+private:
+	typedef interpreter::opCodes opCodes;
+	typedef interpreter::progStat progStat;
+	typedef unsigned laneMask;		// bit l for lane l
+
+	// lanes waiting to run from pc up to join in the frame at joinFp, with tos and fp; the stack
+	// is as deep at a join as at the jump, whether the lanes that ran before reached it or stopped
+	struct split { int pc, join, joinFp; laneMask mask; int tos, fp; };
+
+	vector<interpreter::pInstruction> code;
+	vector<int> ipdom;			// of each instruction, -1 where that is the end of the program
+	vector<int> s;				// (stackMax + 1) * laneCount, cell k of lane l at k * laneCount + l
+	int stackTop;				// as far as tos may go, that of the interpreter taken over
+	vector<split> splits;
+	string screen[laneCount];
+
+	int pc, join, joinFp, tos, fp;
+	laneMask mask, alive;		// the lanes running now, and those not stopped yet
+
+	int *cell(int k) { return &s[(size_t)k * laneCount]; }
+	void postDominators(void);
+	void stop(laneMask lanes, progStat ps);
+	bool popBy(int i);
+	bool pushBy(int i);
+	void branch(laneMask taken, int target, int skip = 0);
+	void branchTable(const int *target);
+	void bulk(opCodes op, int size);
+	void step(void);
+}; // class laneInterpreter
+
+/*==================================================================*/
+/*==================================================================*/
+
+//-----------//
+//CONSTRUCTOR//
+//-----------//
+inline laneInterpreter::laneInterpreter(const interpreter &loaded) : code(loaded.memory.pCode), s((size_t)(stackMax + 1) * laneCount), stackTop(loaded.memory.stackTop), pc(0), join(-1), joinFp(0), tos(0), fp(0), mask(0), alive(0)
+{
+	postDominators();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void postDominators(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void laneInterpreter::postDominators(void)
+{
+	// the dominators of the reversed control flow graph, whose root is a node n after the last
+	// instruction that HLT and NUL lead to (Cooper, Harvey and Kennedy, "A Simple, Fast Dominance
+	// Algorithm"); nodes are numbered in postorder of a depth first search from n
+	int n = (int)code.size();
+	vector<vector<int> > succ(n + 1), pred(n + 1);
+	for (int i = 0; i < n; i++)
+	{
+		interpreter::pInstruction &in = code[i];
+		bool jumps = in.op == interpreter::jmp || in.op == interpreter::jmz || (in.op >= interpreter::jeq && in.op <= interpreter::jge) || in.op == interpreter::tcl ||
+			in.op == interpreter::lop;
+		bool ends = in.op == interpreter::hlt || in.op == interpreter::nul || in.op == interpreter::ret;
+		if (ends) succ[i].push_back(n);
+		else if (jumps) succ[i].push_back(in.arg >= 0 && in.arg < n ? in.arg : n);
+		else if (in.op == interpreter::jtb)
+			for (int k = i + 1; k <= i + 1 + in.arg; k++)
+			{
+				int target = k < n && code[k].op == interpreter::jmp ? code[k].arg : n;
+				succ[i].push_back(target >= 0 && target < n ? target : n);
+			}
+		if (in.op == interpreter::lop)
+			succ[i].push_back(min(i + 4, n));	// past its operands
+		else if (!ends && in.op != interpreter::jmp && in.op != interpreter::tcl && in.op != interpreter::jtb)
+			succ[i].push_back(i + 1);
+		for (int j : succ[i])
+			pred[j].push_back(i);
+	}
+
+	vector<int> order, number(n + 1, -1);
+	vector<pair<int, size_t> > path(1, make_pair(n, (size_t)0));
+	number[n] = -2;
+	while (!path.empty())
+	{
+		int b = path.back().first;
+		if (path.back().second < pred[b].size())
+		{
+			int p = pred[b][path.back().second++];
+			if (number[p] == -1) { number[p] = -2; path.push_back(make_pair(p, (size_t)0)); }
+		}
+		else
+		{
+			number[b] = (int)order.size();
+			order.push_back(b);
+			path.pop_back();
+		}
+	}
+
+	vector<int> dom(n + 1, -1);
+	dom[n] = n;
+	for (bool changed = true; changed; )
+	{
+		changed = false;
+		for (int k = (int)order.size() - 2; k >= 0; k--)
+		{
+			int b = order[k], d = -1;
+			for (int p : succ[b])
+			{
+				if (dom[p] == -1) continue;
+				if (d == -1) { d = p; continue; }
+				int x = p;
+				while (x != d)
+				{
+					while (number[x] < number[d]) x = dom[x];
+					while (number[d] < number[x]) d = dom[d];
+				}
+			}
+			if (dom[b] != d) { dom[b] = d; changed = true; }
+		}
+	}
+	ipdom.assign(n, -1);
+	for (int i = 0; i < n; i++)
+		if (dom[i] != -1 && dom[i] != n) ipdom[i] = dom[i];
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//	void runRecords(const vector<int> &address, const vector<vector<int> > &value, int lanes)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void laneInterpreter::runRecords(const vector<int> &address, const vector<vector<int> > &value, int lanes)
+{
+	// as interpreter::runRecord: the variables and arrays are cleared in every lane, the stack is not
+	int area = !code.empty() && code[0].op == interpreter::inc ? min(code[0].arg, stackMax) : 0;
+	fill(s.begin() + laneCount, s.begin() + (size_t)(1 + area) * laneCount, 0);
+	for (int l = 0; l < lanes; l++)
+	{
+		screen[l].clear();
+		for (size_t k = 0; k < address.size(); k++)
+			if (address[k] > 0 && address[k] <= area) cell(address[k])[l] = value[l][k];
+	}
+	pc = 0;
+	join = -1;
+	joinFp = tos = fp = 0;
+	alive = mask = lanes >= laneCount ? ~0u >> (32 - laneCount) : (1u << lanes) - 1;
+	splits.clear();
+	for (;;)
+	{
+		// the lanes that waited for those running now go on where these have reached, or stopped
+		while ((pc == join && fp == joinFp) || mask == 0)
+		{
+			if (splits.empty()) return;
+			split &next = splits.back();
+			pc = next.pc;
+			join = next.join;
+			joinFp = next.joinFp;
+			mask = next.mask & alive;
+			tos = next.tos;
+			fp = next.fp;
+			splits.pop_back();
+		}
+		step();
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void stop(laneMask lanes, progStat ps)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void laneInterpreter::stop(laneMask lanes, progStat ps)
+{
+	// with the message of interpreter::postMortem, for the instruction just fetched
+	lanes &= mask;
+	for (int l = 0; l < laneCount; l++)
+		if (lanes >> l & 1)
+			screen[l].append("Error: ").append(interpreter::statusText(ps)).append(" at instruction ").append(to_string(pc - 1)).append(".\n");
+	mask &= ~lanes;
+	alive &= ~lanes;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							bool popBy(int i)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool laneInterpreter::popBy(int i)
+{
+	// the top of stack is shared, so a stack error stops every lane running
+	tos = tos - i;
+	if (tos < 0) { stop(mask, interpreter::lowchk); return false; }
+	return true;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							bool pushBy(int i)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool laneInterpreter::pushBy(int i)
+{
+	// a deep stack grows as interpreter::growStack() does
+	tos = tos + i;
+	if (tos > stackMax && (size_t)tos * laneCount >= s.size())
+	{
+		if (tos > stackTop) { stop(mask, interpreter::stkchk); return false; }
+		s.resize((min((size_t)stackTop, max(s.size() / laneCount - 1 + stackMax, (size_t)tos)) + 1) * laneCount, 0);
+	}
+	return true;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				void branch(laneMask taken, int target, int skip)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void laneInterpreter::branch(laneMask taken, int target, int skip)
+{
+	// pc is already past the jump, the lanes that do not take it go on skip instructions
+	// further; lanes that disagree are split until its post-dominator
+	taken &= mask;
+	if (taken == mask) { pc = target; return; }
+	int r = ipdom[pc - 1];
+	pc = pc + skip;
+	if (taken == 0) return;
+	splits.push_back({ r, join, joinFp, mask, tos, fp });
+	if (pc != r) splits.push_back({ pc, r, fp, mask & ~taken, tos, fp });
+	pc = target;
+	join = r;
+	joinFp = fp;
+	mask = taken;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void branchTable(const int *target)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void laneInterpreter::branchTable(const int *target)
+{
+	// as branch(), with a group of lanes for each target of a JTB; the first runs first
+	laneMask rest = mask, group = 0;
+	int r = ipdom[pc - 1], first = -1;
+	while (rest != 0)
+	{
+		int lead = 0;
+		while (!(rest >> lead & 1)) lead++;
+		laneMask same = 0;
+		for (int l = lead; l < laneCount; l++)
+			if ((rest >> l & 1) && target[l] == target[lead]) same |= 1u << l;
+		rest &= ~same;
+		if (first < 0)
+		{
+			if (rest == 0) { pc = target[lead]; return; }
+			splits.push_back({ r, join, joinFp, mask, tos, fp });
+			first = target[lead];
+			group = same;
+		}
+		else if (target[lead] != r)
+			splits.push_back({ target[lead], r, fp, same, tos, fp });
+	}
+	pc = first;
+	join = r;
+	joinFp = fp;
+	mask = group;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void bulk(opCodes op, int size)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void laneInterpreter::bulk(opCodes op, int size)
+{
+	// the elements of an array of one lane are laneCount cells apart
+	int *top = cell(tos);
+	for (int l = 0; l < laneCount; l++)
+	{
+		if (!(mask >> l & 1)) continue;
+		int *a = &s[(size_t)top[l] * laneCount + l], *b, *c, v;
+		switch (op)
+		{
+		case interpreter::vsm:
+			v = 0;
+			for (int k = 0; k < size; k++) v = (int)((unsigned)v + (unsigned)a[k * laneCount]);
+			top[l] = v;
+			break;
+		case interpreter::vmn:
+			v = a[0];
+			for (int k = 1; k < size; k++) v = min(v, a[k * laneCount]);
+			top[l] = v;
+			break;
+		case interpreter::vmx:
+			v = a[0];
+			for (int k = 1; k < size; k++) v = max(v, a[k * laneCount]);
+			top[l] = v;
+			break;
+		case interpreter::vfl:
+			c = &s[(size_t)top[laneCount + l] * laneCount + l];
+			for (int k = 0; k < size; k++) c[k * laneCount] = top[2 * laneCount + l];
+			break;
+		case interpreter::vcp:
+			c = &s[(size_t)top[laneCount + l] * laneCount + l];
+			a = &s[(size_t)top[2 * laneCount + l] * laneCount + l];
+			for (int k = 0; k < size; k++) c[k * laneCount] = a[k * laneCount];
+			break;
+		default:
+			c = &s[(size_t)top[laneCount + l] * laneCount + l];
+			a = &s[(size_t)top[2 * laneCount + l] * laneCount + l];
+			b = &s[(size_t)top[3 * laneCount + l] * laneCount + l];
+			for (int k = 0; k < size; k++)
+			{
+				unsigned x = a[k * laneCount], y = b[k * laneCount];
+				c[k * laneCount] = (int)(op == interpreter::vad ? x + y : op == interpreter::vsb ? x - y : x * y);
+			}
+			break;
+		}
+	}
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void step(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void laneInterpreter::step(void)
+{
+	// one instruction for all the lanes running; arithmetic is done in every lane, whatever
+	// it finds in those that are not running is never stored or written
+	if (pc < 0 || pc >= (int)code.size()) { pc = pc + 1; stop(mask, interpreter::opchk); return; }
+	interpreter::pInstruction i = code[pc];
+	pc = pc + 1;
+	int *a, *b;
+	laneMask t = 0;
+	switch (i.op)
+	{
+	case interpreter::nul: stop(mask, interpreter::opchk); break;
+	case interpreter::add: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = (int)((unsigned)a[l] + (unsigned)b[l]);
+		break;
+	case interpreter::sub: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = (int)((unsigned)a[l] - (unsigned)b[l]);
+		break;
+	case interpreter::mul: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = (int)((unsigned)a[l] * (unsigned)b[l]);
+		break;
+	case interpreter::dvd: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1)
+			{
+				if (b[l] == 0) t |= 1u << l;
+				else a[l] = a[l] / b[l];
+			}
+		if (t) stop(t, interpreter::divchk);
+		break;
+	case interpreter::eql: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = a[l] == b[l];
+		break;
+	case interpreter::neq: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = a[l] != b[l];
+		break;
+	case interpreter::gtr: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = a[l] > b[l];
+		break;
+	case interpreter::geq: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = a[l] >= b[l];
+		break;
+	case interpreter::lss: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = a[l] < b[l];
+		break;
+	case interpreter::leq: if (!popBy(1)) break;
+		a = cell(tos); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) a[l] = a[l] <= b[l];
+		break;
+	case interpreter::ldi: case interpreter::lda: if (!pushBy(1)) break;
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++) a[l] = i.arg;
+		break;
+	case interpreter::ldv:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1) a[l] = s[(size_t)a[l] * laneCount + l];
+		break;
+	case interpreter::shl:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++) a[l] = (int)((unsigned)a[l] << i.arg);
+		break;
+	case interpreter::sar:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++) a[l] = (a[l] + ((a[l] >> 31) & ((1 << i.arg) - 1))) >> i.arg;
+		break;
+	case interpreter::mli:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++) a[l] = (int)((unsigned)a[l] * (unsigned)i.arg);
+		break;
+	case interpreter::dvi:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++)
+		{
+			int n = a[l];
+			int q = (int)(((long long)i.arg * n) >> 32);
+			if (i.aux & 0x100) q += n;
+			if (i.aux & 0x200) q -= n;
+			q >>= (i.aux & 0xff);
+			a[l] = q + (int)((unsigned)q >> 31);
+		}
+		break;
+	case interpreter::sto: if (!popBy(2)) break;
+		a = cell(tos + 1); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1) s[(size_t)a[l] * laneCount + l] = b[l];
+		break;
+	case interpreter::inc: pushBy(i.arg); break;
+	case interpreter::chk:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++)
+			if (a[l] < 0 || a[l] >= i.arg) t |= 1u << l;
+		if (t & mask) stop(t, interpreter::idxchk);
+		break;
+	case interpreter::ldx:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1) a[l] = s[(size_t)(i.arg + a[l]) * laneCount + l];
+		break;
+	case interpreter::stx: if (!popBy(2)) break;
+		a = cell(tos + 1); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1) s[(size_t)(i.arg + a[l]) * laneCount + l] = b[l];
+		break;
+	case interpreter::vsm: case interpreter::vmn: case interpreter::vmx:
+		bulk(i.op, i.arg); break;
+	case interpreter::vfl: case interpreter::vcp: if (!popBy(2)) break;
+		bulk(i.op, i.arg); break;
+	case interpreter::vad: case interpreter::vsb: case interpreter::vml: if (!popBy(3)) break;
+		bulk(i.op, i.arg); break;
+	case interpreter::rdi: if (pushBy(1)) stop(mask, interpreter::eofchk); break;
+	case interpreter::eoi: if (!pushBy(1)) break;
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++) a[l] = 1;
+		break;
+	case interpreter::jmp: pc = i.arg; break;
+	case interpreter::cal: if (!pushBy(2)) break;
+		a = cell(tos - 1); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++) { a[l] = pc; b[l] = fp; }
+		fp = tos;
+		pc = i.arg;
+		break;
+	case interpreter::ent: if (!pushBy(i.arg)) break;
+		fill(s.begin() + (size_t)(tos - i.arg + 1) * laneCount, s.begin() + (size_t)(tos + 1) * laneCount, 0);
+		break;
+	case interpreter::ret:
+	{
+		// the lanes running were called by the same CAL, the first of them tells where from
+		int first = 0;
+		while (!(mask >> first & 1)) first++;
+		if (fp < 2) { stop(mask, interpreter::lowchk); break; }
+		tos = fp;
+		pc = cell(tos - 1)[first];
+		fp = cell(tos)[first];
+		popBy(2 + i.arg);
+		break;
+	}
+	case interpreter::lla: if (!pushBy(1)) break;
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++) a[l] = fp + i.arg;
+		break;
+	case interpreter::tcl:
+	{
+		// only the lanes running pass arguments, those waiting in the frame keep their own
+		int args = i.arg < (int)code.size() && code[i.arg].op == interpreter::ent ? tos - fp - code[i.arg].arg : -1;
+		if (args < 0 || fp - 1 - args < 1) { stop(mask, interpreter::lowchk); break; }
+		for (int k = 0; k < args; k++)
+		{
+			a = cell(fp - 1 - args + k); b = cell(tos - args + 1 + k);
+			for (int l = 0; l < laneCount; l++)
+				if (mask >> l & 1) a[l] = b[l];
+		}
+		tos = fp;
+		pc = i.arg;
+		break;
+	}
+	case interpreter::jtb: if (!popBy(1)) break;
+	{
+		int target[laneCount];
+		a = cell(tos + 1);
+		for (int l = 0; l < laneCount; l++)
+		{
+			int entry = pc + ((unsigned)a[l] < (unsigned)i.arg ? a[l] : i.arg);
+			if (entry < (int)code.size() && code[entry].op == interpreter::jmp) target[l] = code[entry].arg;
+			else t |= 1u << l;
+		}
+		if (t & mask) stop(t, interpreter::opchk);
+		if (mask != 0) branchTable(target);
+		break;
+	}
+	case interpreter::lop:
+	{
+		// the operands that follow are those of every lane; only the lanes running step
+		const interpreter::pInstruction *w = pc + 2 < (int)code.size() ? &code[pc] : nullptr;
+		if (w == nullptr || (w[0].op != interpreter::lda && w[0].op != interpreter::lla) ||
+			(w[1].op != interpreter::lda && w[1].op != interpreter::lla) || w[2].op != interpreter::ldi || w[2].arg == 0)
+		{
+			stop(mask, interpreter::opchk);
+			break;
+		}
+		a = cell(w[0].op == interpreter::lla ? fp + w[0].arg : w[0].arg);
+		b = cell(w[1].op == interpreter::lla ? fp + w[1].arg : w[1].arg);
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1)
+			{
+				long long next = (long long)a[l] + w[2].arg;	// as in interpreter::nextStep(), it does not wrap
+				a[l] = (int)next;
+				t |= (laneMask)(w[2].arg > 0 ? next <= b[l] : next >= b[l]) << l;
+			}
+		branch(t, i.arg, 3);
+		break;
+	}
+	case interpreter::jmz: if (!popBy(1)) break;
+		a = cell(tos + 1);
+		for (int l = 0; l < laneCount; l++) t |= (laneMask)(a[l] == 0) << l;
+		branch(t, i.arg);
+		break;
+	case interpreter::jeq: case interpreter::jne: case interpreter::jlt:
+	case interpreter::jle: case interpreter::jgt: case interpreter::jge: if (!popBy(2)) break;
+		a = cell(tos + 1); b = a + laneCount;
+		for (int l = 0; l < laneCount; l++)
+		{
+			bool c;
+			switch (i.op)
+			{
+			case interpreter::jeq: c = a[l] == b[l]; break;
+			case interpreter::jne: c = a[l] != b[l]; break;
+			case interpreter::jlt: c = a[l] < b[l]; break;
+			case interpreter::jle: c = a[l] <= b[l]; break;
+			case interpreter::jgt: c = a[l] > b[l]; break;
+			default:               c = a[l] >= b[l]; break;
+			}
+			t |= (laneMask)c << l;
+		}
+		branch(t, i.arg);
+		break;
+	case interpreter::prn:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1)
+			{
+				char digits[12];
+				screen[l].append(digits, to_chars(digits, digits + sizeof digits, a[l]).ptr);
+			}
+		popBy(1);
+		break;
+	case interpreter::prc:
+		a = cell(tos);
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1) screen[l].append(1, (char)a[l]);
+		popBy(1);
+		break;
+	case interpreter::prs:
+	{
+		// the length and the characters were pushed by LDI, the same in every lane
+		int length = cell(tos)[0];
+		if (!popBy(length)) break;
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1)
+				for (int k = 0; k < length; k++) screen[l].append(1, (char)cell(tos + k)[l]);
+		popBy(1);
+		break;
+	}
+	case interpreter::nln:
+		for (int l = 0; l < laneCount; l++)
+			if (mask >> l & 1) screen[l].append(1, '\n');
+		break;
+	case interpreter::hlt: alive &= ~mask; mask = 0; break;
+	}
+} // step
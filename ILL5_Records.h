@@ -0,0 +1,256 @@
+#pragma once
+/*	CLASS recordRunner
+
+Runs an HLL6 program once for every record of an input, the way awk runs its program for every
+line. The program is compiled and its code loaded once; for each record the variables and arrays
+are cleared and the fields of the record, integers separated by blanks or tabs, are stored in the
+variables F1, F2, ... up to recordFields of them. NF is set to the number of fields and NR to the
+number of the record, counting from 1. The program declares those it uses, and any it does not
+are left alone. Nothing is carried from one record to the next; READ has nothing to read.
+
+A record is a line of the input. The records are taken recordChunk at a time and shared among the
+threads, each with an interpreter of its own that keeps its code and memory from record to record.
+Whatever order the chunks finish in, the output of the records is written in the order of the
+records. A record with a field that is not an integer is not run, an error is written instead.
+
+Unless told otherwise, a thread runs laneCount records at once on a laneInterpreter (see
+ILL5_Lanes.h), which dispatches each instruction once for all of them; a record left on its own
+is run by the interpreter.
+
+	recordRunner runner("Report.txt");			// compiles Report.txt to Report.OUT.txt
+	if (runner.compiled()) runner.run("Sales.txt", cout);	// "" reads the standard input
+	else cout << runner.diagnostics();
+
+*/
+
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <filesystem>
+#include <charconv>
+#include "HLL6_Compiler.h"
+#include "ILL5_Interpreter.h"
+#include "ILL5_Lanes.h"
+
+using namespace std;
+
+#define recordFields 16		//fields bound to F1 .. F16
+#define recordChunk 1024	//records a thread takes at a time
+
+/*=============================================================*/
+
+class recordRunner
+{
+public:
+	// threads == 0 takes one thread per core; lanes runs records laneCount at a time
+	recordRunner(const string &sourceName, unsigned threads = 0, bool lanes = true);
+	~recordRunner() {}
+
+	bool compiled(void) { return isCompiled; }
+	const string &diagnostics(void) { return messages; }
+	long long run(const string &inputName, ostream &out);		// the number of records, -1 if the input cannot be opened
+
+private:
+	struct chunk { vector<string> lines; size_t count; string output; long long firstRecord; };
+
+	bool isCompiled;
+	string messages;			// of the compiler, and of loading the code
+	string objectName;
+	unsigned threads;
+	vector<int> address;		// of F1 .. F(recordFields), NF and NR, 0 for those not used
+	vector<unique_ptr<interpreter> > vms;	// one per thread
+	vector<unique_ptr<laneInterpreter> > laneVms;	// one per thread, if records are run in lanes
+	vector<unique_ptr<ostringstream> > screens;	// where each of them writes
+	vector<chunk> chunks;		// one round of records
+	atomic<size_t> nextChunk;
+
+	void worker(unsigned vm, size_t used);
+	void runChunk(unsigned vm, chunk &c, vector<vector<int> > &value);
+	void runBatch(unsigned vm, vector<vector<int> > &value, int &lanes);
+	bool fields(const string &line, vector<int> &value, int &bad);
+}; // class recordRunner
+
+/*==================================================================*/
+/*==================================================================*/
+
+//-----------//
+//CONSTRUCTOR//
+//-----------//
+inline recordRunner::recordRunner(const string &sourceName, unsigned threads, bool lanes) : isCompiled(false), threads(threads), nextChunk(0)
+{
+	ostringstream console;
+	compiler::compileOptions options;
+	options.sourceName = sourceName;
+	options.objectName = filesystem::path(sourceName).replace_extension(".OUT.txt").string();
+	options.listing = compiler::listNone;
+	options.console = &console;
+	objectName = options.objectName;
+
+	compiler recordCompiler(options);
+	messages = console.str();
+	if (!recordCompiler.compiled()) return;
+	for (int k = 1; k <= recordFields; k++)
+		address.push_back(recordCompiler.addressOf("F" + to_string(k)));
+	address.push_back(recordCompiler.addressOf("NF"));
+	address.push_back(recordCompiler.addressOf("NR"));
+
+	if (this->threads == 0) this->threads = max(1u, thread::hardware_concurrency());
+	for (unsigned t = 0; t < this->threads; t++)
+	{
+		screens.emplace_back(new ostringstream);
+		vms.emplace_back(new interpreter(objectName.c_str(), *screens.back()));
+		if (vms.back()->hasErrors) { messages = screens.back()->str(); return; }
+		if (lanes) laneVms.emplace_back(new laneInterpreter(*vms.back()));
+	}
+	chunks.resize(this->threads * 4);
+	isCompiled = true;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				long long run(const string &inputName, ostream &out)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline long long recordRunner::run(const string &inputName, ostream &out)
+{
+	// a round reads as many chunks as there are, runs them on all threads and writes their
+	// output in order; the lines and the output of a chunk keep their memory from round to round
+	ifstream file;
+	if (!inputName.empty())
+	{
+		file.open(inputName, ios::binary);
+		if (!file) return -1;
+	}
+	istream &in = inputName.empty() ? cin : file;
+	long long records = 0;
+	while (isCompiled && in)
+	{
+		size_t used = 0;
+		for (; used < chunks.size() && in; used++)
+		{
+			chunk &c = chunks[used];
+			c.firstRecord = records + 1;
+			for (c.count = 0; c.count < recordChunk; c.count++)
+			{
+				if (c.count == c.lines.size()) c.lines.emplace_back();
+				if (!getline(in, c.lines[c.count])) break;
+			}
+			records += c.count;
+		}
+
+		nextChunk = 0;
+		if (threads <= 1 || used <= 1) worker(0, used);
+		else
+		{
+			vector<thread> pool;
+			for (unsigned t = 0; t < threads; t++)
+				pool.emplace_back(&recordRunner::worker, this, t, used);
+			for (thread &t : pool)
+				t.join();
+		}
+		for (size_t k = 0; k < used; k++)
+			out << chunks[k].output;
+	}
+	return records;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void worker(unsigned vm, size_t used)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void recordRunner::worker(unsigned vm, size_t used)
+{
+	// each chunk is taken by exactly one thread
+	vector<vector<int> > value(laneCount, vector<int>(address.size()));
+	for (size_t i; (i = nextChunk.fetch_add(1, memory_order_relaxed)) < used; )
+		runChunk(vm, chunks[i], value);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		void runChunk(unsigned vm, chunk &c, vector<vector<int> > &value)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void recordRunner::runChunk(unsigned vm, chunk &c, vector<vector<int> > &value)
+{
+	// the records are gathered in value[0 .. lanes-1], a batch that is run when it is full,
+	// before a record that is not run, and at the end of the chunk
+	ostringstream &screen = *screens[vm];
+	screen.str("");
+	int lanes = 0;
+	for (size_t n = 0; n < c.count; n++)
+	{
+		int bad;
+		vector<int> &record = value[lanes];
+		record[recordFields + 1] = (int)(c.firstRecord + n);
+		if (!fields(c.lines[n], record, bad))
+		{
+			runBatch(vm, value, lanes);
+			screen << "Error: Field " << bad << " of record " << record[recordFields + 1] << " is not an integer." << endl;
+		}
+		else if (++lanes == (laneVms.empty() ? 1 : laneCount))
+			runBatch(vm, value, lanes);
+	}
+	runBatch(vm, value, lanes);
+	c.output = screen.str();
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		void runBatch(unsigned vm, vector<vector<int> > &value, int &lanes)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void recordRunner::runBatch(unsigned vm, vector<vector<int> > &value, int &lanes)
+{
+	if (lanes == 1)
+		vms[vm]->runRecord(address, value[0]);
+	else if (lanes > 1)
+	{
+		laneInterpreter &batch = *laneVms[vm];
+		batch.runRecords(address, value, lanes);
+		for (int l = 0; l < lanes; l++)
+			*screens[vm] << batch.output(l);
+	}
+	lanes = 0;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//		bool fields(const string &line, vector<int> &value, int &bad)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline bool recordRunner::fields(const string &line, vector<int> &value, int &bad)
+{
+	// F1 .. F(recordFields) and NF of a record; fields after the last one bound are counted only
+	const char *p = line.data(), *end = p + line.size();
+	int nf = 0;
+	for (;;)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+		if (p == end) break;
+		int v = 0;
+		from_chars_result r = from_chars(p, end, v);
+		if (r.ec != errc() || (r.ptr < end && *r.ptr != ' ' && *r.ptr != '\t' && *r.ptr != '\r')) { bad = nf + 1; return false; }
+		if (nf < recordFields) value[nf] = v;
+		nf++;
+		p = r.ptr;
+	}
+	for (int k = nf; k < recordFields; k++) value[k] = 0;
+	value[recordFields] = nf;
+	return true;
+}
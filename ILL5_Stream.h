@@ -0,0 +1,139 @@
+#pragma once
+/*	CLASS codeStream
+
+A single-producer, single-consumer queue of ILL5 p-instructions, used to run a program while it
+is still being compiled. The HLL6 compiler puts the instructions of each finished top-level
+statement, its forward jumps already back-patched, and publishes them; the ILL5 interpreter, on
+another thread, takes them as soon as they are published and starts executing the prefix it has.
+An instruction is passed as it is written in the object file, a mnemonic and an argument.
+
+The queue is a ring of streamRing slots. The producer waits while the ring is full and the
+consumer while it is empty; close() ends the stream and tells the consumer whether the program
+compiled. A consumer that stops early, say at a run-time error, calls stop() so that the producer
+no longer waits for it.
+
+	codeStream stream;
+	thread run([&stream] { interpreter myInterpreter(stream); });
+	compiler::compileOptions options;
+	options.listing = compiler::listFile;	// keep the listing off the program's output
+	options.stream = &stream;
+	compiler myCompiler(options);
+	run.join();
+
+*/
+
+#include <atomic>
+#include <thread>
+#include <cstring>
+#include <cstddef>
+
+using namespace std;
+
+#define streamRing 4096		//slots of the ring, a power of 2
+
+/*=============================================================*/
+
+class codeStream
+{
+public:
+	struct instruction { char op[4]; int arg; };
+
+	codeStream(void) : head(0), tail(0), state(open), stopped(false), written(0), freed(0), taken(0) {}
+	~codeStream() {}
+
+	// producer side
+	void put(const char *op, int arg);
+	void publish(void) { head.store(written, memory_order_release); }
+	void close(bool compiled);
+
+	// consumer side
+	size_t take(instruction *to, size_t max);
+	bool compiled(void) { return state.load(memory_order_acquire) == done; }
+	void stop(void) { stopped.store(true, memory_order_release); }
+
+private:
+	enum streamState { open, done, failed };
+
+	instruction ring[streamRing];
+	alignas(64) atomic<size_t> head;	// instructions published
+	alignas(64) atomic<size_t> tail;	// instructions taken
+	alignas(64) atomic<int> state;
+	atomic<bool> stopped;				// the consumer takes no more
+
+	alignas(64) size_t written, freed;	// producer's own: instructions put, and taken as last seen
+	alignas(64) size_t taken;			// consumer's own: instructions taken
+}; // class codeStream
+
+/*==================================================================*/
+/*==================================================================*/
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void put(const char *op, int arg)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void codeStream::put(const char *op, int arg)
+{
+	// when the ring is full, publish what there is and wait for the consumer, if it is still there
+	if (written - freed == streamRing)
+	{
+		publish();
+		while ((freed = tail.load(memory_order_acquire)) + streamRing == written)
+		{
+			if (stopped.load(memory_order_acquire)) return;
+			this_thread::yield();
+		}
+	}
+	instruction &slot = ring[written & (streamRing - 1)];
+	memcpy(slot.op, op, 4);
+	slot.arg = arg;
+	written++;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void close(bool compiled)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline void codeStream::close(bool compiled)
+{
+	// publish the rest and end the stream; a second close changes nothing
+	if (state.load(memory_order_relaxed) != open) return;
+	publish();
+	state.store(compiled ? done : failed, memory_order_release);
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				size_t take(instruction *to, size_t max)
+//
+//*******************************************************************//
+//*******************************************************************//
+inline size_t codeStream::take(instruction *to, size_t max)
+{
+	// copy up to max published instructions, waiting until there is one;
+	// 0 means the stream is closed and everything has been taken
+	size_t available;
+	tail.store(taken, memory_order_release);
+	while ((available = head.load(memory_order_acquire)) == taken)
+	{
+		if (state.load(memory_order_acquire) != open)
+		{
+			available = head.load(memory_order_acquire);
+			if (available == taken) return 0;
+			break;
+		}
+		this_thread::yield();
+	}
+
+	size_t n = 0;
+	for (; n < max && taken < available; n++, taken++)
+		to[n] = ring[taken & (streamRing - 1)];
+	tail.store(taken, memory_order_release);
+	return n;
+}
@@ -0,0 +1,453 @@
+/*	PROGRAM LexBench
+
+Times the HLL6 lexer alone, without parsing, on a source held in memory, so that changes to the
+lexer can be measured. It is a program of its own, built beside Source.cpp:
+
+	g++ -std=c++17 -O2 LexBench.cpp -o LexBench
+
+	LexBench -make <megabytes> <file>		writes a generated HLL6 source of about that size
+	LexBench [-list] [-old] [-runs <n>] [-repeat <n>] <file>
+											lexes the file n times, 5 if not given, and reports the
+											best run; -list keeps the listing in memory as well,
+											-old lexes with the hand-written lexer instead of
+											parseSymbol(), and -repeat lexes the file n times over in one text
+	LexBench -fuzz <n>						lexes n random symbol soups with both lexers, and
+											reports the first one they lex differently
+
+The generated source is a long program of assignments, WRITEs, IFs, WHILEs and FORs over a few
+hundred variables, indented as a person would; it is the same for the same size on any machine.
+The lexer is run by getSym() until the end of the source, as the parser would, and each run starts
+from the beginning of the text.
+
+The hand-written lexer is the switch over the first character of a symbol that parseSymbol() was
+before the DFA table took the fixed symbols of more than one character and identifiers, numbers
+and strings got loops of their own; it is kept here to compare the two, with only the symbols the
+language has gained since, '[', ']' and a ':' of its own, added to it. The TestFiles
+repeated 10,000 times are the comparison of that change:
+
+	LexBench -old -runs 40 -repeat 10000 TestFile1.txt
+	LexBench -runs 40 -repeat 10000 TestFile1.txt
+
+The soups of -fuzz are strings of pieces of symbols and of what is not one: bad characters, a ':'
+apart from its '=', unterminated strings, CR LF line ends, numbers that overflow, and the end of the
+source inside a symbol. For each symbol the two lexers must give the same symbol, value, position
+and errors.
+
+*/
+
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <random>
+#include <chrono>
+#include "HLL6_Compiler.h"
+
+using namespace std;
+
+/*=============================================================*/
+
+class lexerBench
+{
+public:
+	lexerBench(void);
+	~lexerBench() {}
+
+	void load(const string &text, bool list);
+	long lex(bool old, ostream *trace = nullptr);
+	double best(int runs, bool old, long &symbols);
+
+	static string generate(size_t bytes);
+	static string soup(mt19937 &rng);
+
+private:
+	ostringstream quiet;	// the console of the compiler, which nobody reads
+	compiler c;
+
+	static compiler::compileOptions options(ostream &console);
+	void handSymbol(void);
+	void traceSymbol(ostream &trace);
+}; // class lexerBench
+
+/*==================================================================*/
+/*==================================================================*/
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							lexerBench(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+lexerBench::lexerBench(void) : c(options(quiet)) {}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//			compiler::compileOptions options(ostream &console)
+//
+//*******************************************************************//
+//*******************************************************************//
+compiler::compileOptions lexerBench::options(ostream &console)
+{
+	// the compiler is made on a source that cannot be opened, so it stops at once; it is given
+	// its text by load()
+	compiler::compileOptions options;
+	options.listing = compiler::listNone;
+	options.sourceName = "<lexer benchmark>";
+	options.console = &console;
+	return options;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					void load(const string &text, bool list)
+//
+//*******************************************************************//
+//*******************************************************************//
+void lexerBench::load(const string &text, bool list)
+{
+	c.source = text;
+	c.listMode = list ? compiler::listMemory : compiler::listNone;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					long lex(bool old, ostream *trace)
+//
+//*******************************************************************//
+//*******************************************************************//
+long lexerBench::lex(bool old, ostream *trace)
+{
+	// lex the source from its start to the '\0' after its end, by the hand-written lexer if old;
+	// the symbols read. With a trace every symbol is written to it, and every error.
+	c.srcPos = c.lineStart = c.source.data();
+	c.srcEnd = c.srcPos + c.source.size();
+	c.srcDone = false;
+	c.lineNo = 1;
+	c.ch = ' ';
+	c.hasError = false;
+	c.nextCode = 0;
+	c.listing.str("");
+
+	long symbols = 0;
+	while (c.ch != '\0')
+	{
+		if (old)
+		{
+			c.skipBlanks();
+			c.symStart = c.srcPos - 1;
+			c.sym = compiler::unknownSym;
+			handSymbol();
+		}
+		else
+			c.getSym();
+		symbols++;
+		if (trace != nullptr) traceSymbol(*trace);
+	}
+	if (trace != nullptr) *trace << c.listing.str();
+	return symbols;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//				double best(int runs, bool old, long &symbols)
+//
+//*******************************************************************//
+//*******************************************************************//
+double lexerBench::best(int runs, bool old, long &symbols)
+{
+	// the shortest of runs lexes, in seconds
+	double fastest = 0;
+	for (int r = 0; r < runs; r++)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		symbols = lex(old);
+		double took = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if (r == 0 || took < fastest) fastest = took;
+	}
+	return fastest;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						void traceSymbol(ostream &trace)
+//
+//*******************************************************************//
+//*******************************************************************//
+void lexerBench::traceSymbol(ostream &trace)
+{
+	// the symbol just read and where the lexer stopped; the error of a symbol goes to the listing
+	trace << c.sym << ' ' << c.lineNo << ' ' << (c.srcPos - c.source.data()) << ' ' << c.srcDone << ' '
+		<< (int)(unsigned char)c.ch;
+	if (c.sym == compiler::varIdentSym) trace << " id " << c.id << ' ' << c.idHash;
+	else if (c.sym == compiler::numberSym) trace << " number " << c.number;
+	else if (c.sym == compiler::stringSym) trace << " string " << c.chStringLen << ' ' << c.chStringText;
+	trace << '\n';
+	c.hasError = false;	// so that each error is listed, not only the first
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//							void handSymbol(void)
+//
+//*******************************************************************//
+//*******************************************************************//
+void lexerBench::handSymbol(void)
+{
+	// parseSymbol() as it was before the DFA lexer, with the symbols added since
+	switch (c.ch)
+	{
+	case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i': case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p':
+	case 'q': case 'r': case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y': case 'z':
+	case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I': case 'J': case 'K': case 'L': case 'M': case 'N': case 'O': case 'P':
+	case 'Q': case 'R': case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
+	{
+		c.id.clear();
+		c.idHash = 2166136261u; // FNV-1a
+		do
+		{
+			if ((c.ch >= 'a') && (c.ch <= 'z'))
+				c.ch -= 32;
+			c.id += c.ch;
+			c.idHash = (c.idHash ^ (unsigned char)c.ch) * 16777619u;
+			c.GetCh();
+		} while ((c.ch >= 'A' && c.ch <= 'Z') || (c.ch >= 'a' && c.ch <= 'z') || (c.ch >= '0' && c.ch <= '9'));
+
+		// a reserved word can only be the one word in its hash slot
+		const compiler::resWordRec &word = compiler::resWordTable.slot[compiler::resHash(c.id.c_str(), (int)c.id.size())];
+		if (word.name != nullptr && word.len == (int)c.id.size() && c.id == word.name)
+			c.sym = word.sym;
+		else
+			c.sym = compiler::varIdentSym;
+		break;
+	}
+
+	case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7':
+	case '8': case '9':
+		c.number = 0;
+		c.sym = compiler::numberSym;
+		do
+		{
+			if (c.number <= (MaxInt - (c.ch - '0')) / 10) // overflow?
+				c.number = 10 * c.number + (c.ch - '0');
+			else
+				c.error(1);
+
+			c.GetCh();
+		} while (c.ch <= '9' && c.ch >= '0');
+		break;
+
+	case '*': c.sym = compiler::timesSym;		c.GetCh();  break;
+	case '/': c.sym = compiler::slashSym;		c.GetCh();  break;
+	case '+': c.sym = compiler::plusSym;		c.GetCh();  break;
+	case '-': c.sym = compiler::minusSym;		c.GetCh();  break;
+	case '(': c.sym = compiler::leftParenSym;	c.GetCh();  break;
+	case ')': c.sym = compiler::rightParenSym;	c.GetCh();  break;
+	case ';': c.sym = compiler::semicolonSym;	c.GetCh();  break;
+	case '.': c.sym = compiler::periodSym;		c.GetCh();  break;
+	case ',': c.sym = compiler::commaSym;		c.GetCh();  break;
+	case '"': case '\'':
+	{
+		char startChar = c.ch; c.chStringText.clear();
+		c.GetCh();
+		while (c.ch != startChar)
+		{
+			if (c.ch == '\n' || c.ch == '\r' || c.srcDone)
+			{
+				c.error(17);
+				break;
+			}
+			c.chStringText += c.ch;
+			c.GetCh();
+		}
+		c.chStringLen = (int)c.chStringText.size();
+		c.GetCh();
+		c.sym = compiler::stringSym;
+		break;
+	}
+	case '[': c.sym = compiler::leftBracketSym;	c.GetCh();  break;
+	case ']': c.sym = compiler::rightBracketSym;	c.GetCh();  break;
+	case ':': c.GetCh();
+		if (c.ch == '=') { c.sym = compiler::assignSym; c.GetCh(); }
+		else               c.sym = compiler::colonSym;
+		break;
+	case '<': c.GetCh();
+		if (c.ch == '=') { c.sym = compiler::leqSym; c.GetCh(); }
+		else               c.sym = compiler::lessSym;
+		break;
+	case '=': c.sym = compiler::eqlSym; c.GetCh();
+		break;
+	case '#': c.sym = compiler::neqSym; c.GetCh();
+		break;
+	case '>': c.GetCh();
+		if (c.ch == '=') { c.sym = compiler::geqSym; c.GetCh(); }
+		else               c.sym = compiler::gtrSym;
+		break;
+	default:
+		c.GetCh();	c.error(4);
+	}
+} // handSymbol
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						string soup(mt19937 &rng)
+//
+//*******************************************************************//
+//*******************************************************************//
+string lexerBench::soup(mt19937 &rng)
+{
+	// up to 30 pieces of symbols, of bad ones and of blanks, run together
+	const char *pieces[] = { "abc", "Zz9", "x", "END", "endl", "While", "123", "99999", "0", "32767",
+		"32768", ":=", ":", ": =", "<", "<=", ">", ">=", "=", "#", "+", "-", "*", "/", "(", ")", ";",
+		".", ",", "\"str ing\"", "'q\"x'", "\"open", "'", "\"", "$", "!", "\t", " ", "  ", "\n",
+		"\r\n", "        ", "\x01", "\xff", "{", "[", "]" };
+	const int count = sizeof pieces / sizeof *pieces;
+	string text;
+	for (int n = rng() % 30; n > 0; n--)
+		text += pieces[rng() % count];
+	return text;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//					string generate(size_t bytes)
+//
+//*******************************************************************//
+//*******************************************************************//
+string lexerBench::generate(size_t bytes)
+{
+	// a program of about bytes characters, from a fixed seed
+	mt19937 rng(2017);
+	auto pick = [&rng](int n) { return (int)(rng() % n); };
+	const char *words[] = { "count", "total", "i", "j", "k", "x1", "y2", "limit", "acc", "Index",
+		"value", "max0", "next", "prev", "a", "b", "tmp", "result", "n", "stride" };
+	const char *ops[] = { " + ", " - ", " * ", " / " };
+	const char *rels[] = { " = ", " # ", " < ", " <= ", " > ", " >= " };
+	const char *texts[] = { "\"The total is \"", "'done'", "\"x = \"", "\"Hello, world\"", "' '" };
+	const int names = 300;
+	auto name = [&](void) { int v = pick(names); return string(words[v % 20]) + (v < 20 ? "" : to_string(v)); };
+	auto expr = [&](void)
+	{
+		string e = pick(3) ? name() : to_string(pick(1000));
+		for (int t = pick(4); t > 0; t--)
+		{
+			e += ops[pick(4)];
+			e += pick(5) ? name() : to_string(pick(30000));
+			if (pick(8) == 0) e = "(" + e + ")";
+		}
+		return e;
+	};
+
+	string src = "DECLARE ";
+	for (int v = 0; v < names; v++)
+		src += (v ? ", " : "") + string(words[v % 20]) + (v < 20 ? "" : to_string(v));
+	src += ";\nBEGIN\n";
+	int depth = 1;
+	bool opened = true;	// the last line opened a statement sequence, so none of it is there yet
+	while (src.size() + 16 < bytes)
+	{
+		int kind = pick(depth < 6 ? 10 : 6);
+		if (kind == 5 && depth > 1 && !opened)
+		{
+			depth--;
+			src += string(4 * depth, ' ') + "END\n";
+			continue;
+		}
+		if (!opened) src.insert(src.size() - 1, ";");
+		string line(4 * depth, ' ');
+		opened = kind >= 6;
+		if (kind < 3) line += name() + " := " + expr();
+		else if (kind == 3) line += "WRITE " + (pick(2) ? string(texts[pick(5)]) : name());
+		else if (kind == 4) line += "ENDL";
+		else if (kind == 5) line += "READ " + name();
+		else if (kind < 8) line += (kind == 6 ? "IF " : "WHILE ") + expr() + rels[pick(6)] + expr() + (kind == 6 ? " THEN" : " DO");
+		else line += "FOR " + name() + " := " + expr() + " TO " + expr() + " STEP " + to_string(1 + pick(9)) + " DO";
+		if (opened) depth++;
+		src += line + "\n";
+	}
+	if (opened) src += string(4 * depth, ' ') + "ENDL\n";
+	while (--depth > 0)
+		src += string(4 * depth, ' ') + "END\n";
+	src += "END.\n";
+	return src;
+}
+
+//*******************************************************************//
+//*******************************************************************//
+//
+//						int main(int argc, char **argv)
+//
+//*******************************************************************//
+//*******************************************************************//
+int main(int argc, char **argv)
+{
+	if (argc == 4 && string(argv[1]) == "-make")
+	{
+		ofstream out(argv[3], ios::binary);
+		out << lexerBench::generate((size_t)(atof(argv[2]) * 1000000));
+		return out ? 0 : 1;
+	}
+
+	if (argc == 3 && string(argv[1]) == "-fuzz")
+	{
+		lexerBench bench;
+		mt19937 rng(777);
+		for (int n = 0; n < atoi(argv[2]); n++)
+		{
+			string text = lexerBench::soup(rng);
+			ostringstream hand, dfa;
+			bench.load(text, true);
+			bench.lex(true, &hand);
+			bench.lex(false, &dfa);
+			if (hand.str() != dfa.str())
+			{
+				cout << "soup " << n << " is lexed differently:" << endl << text << endl
+					<< "--- hand-written" << endl << hand.str() << "--- DFA" << endl << dfa.str();
+				return 1;
+			}
+		}
+		cout << atoi(argv[2]) << " soups lexed the same" << endl;
+		return 0;
+	}
+
+	bool list = false, old = false;
+	int runs = 5, repeat = 1, a = 1;
+	for (; a < argc - 1; a++)
+		if (string(argv[a]) == "-list") list = true;
+		else if (string(argv[a]) == "-old") old = true;
+		else if (string(argv[a]) == "-runs" && a + 2 < argc) runs = atoi(argv[++a]);
+		else if (string(argv[a]) == "-repeat" && a + 2 < argc) repeat = atoi(argv[++a]);
+		else break;
+	ifstream file(a == argc - 1 ? argv[a] : "", ios::binary);
+	if (!file || runs < 1 || repeat < 1)
+	{
+		cerr << "usage: LexBench -make <megabytes> <file>" << endl
+			<< "       LexBench [-list] [-old] [-runs <n>] [-repeat <n>] <file>" << endl
+			<< "       LexBench -fuzz <n>" << endl;
+		return 1;
+	}
+	stringstream once;
+	once << file.rdbuf();
+	string text;
+	text.reserve(once.str().size() * repeat);
+	for (int r = 0; r < repeat; r++)
+		text += once.str();
+
+	lexerBench bench;
+	bench.load(text, list);
+	long symbols = 0;
+	double took = bench.best(runs, old, symbols);
+	cout << argv[a] << ": " << text.size() << " bytes, " << symbols << " symbols, best of " << runs
+		<< " runs " << fixed << setprecision(1) << took * 1000 << " ms, " << text.size() / took / 1e6
+		<< " MB/s" << (old ? ", hand-written lexer" : "") << endl;
+	return 0;
+}